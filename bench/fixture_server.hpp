@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// ============================================================================
+// FIXTURE SERVER
+// ============================================================================
+
+// Minimal HTTP/1.1 server on 127.0.0.1 serving pages from memory, so end-to-end
+// benchmarks run without network access. Keep-alive, GET only, one thread per
+// connection.
+class FixtureServer {
+private:
+    int listenFd_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> running_{true};
+    std::thread acceptor_;
+    
+    std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<const std::string>> pages_;
+    std::vector<int> clients_;
+    std::vector<std::thread> connections_;
+    std::atomic<size_t> requests_{0};
+
+public:
+    FixtureServer() {
+        listenFd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd_ < 0) throw std::runtime_error("socket() failed");
+        
+        int reuse = 1;
+        ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0; // Any free port
+        socklen_t length = sizeof(address);
+        if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd_, 128) != 0 ||
+            ::getsockname(listenFd_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            ::close(listenFd_);
+            throw std::runtime_error("Could not listen on 127.0.0.1");
+        }
+        port_ = ntohs(address.sin_port);
+        
+        acceptor_ = std::thread([this] { acceptLoop(); });
+    }
+    
+    ~FixtureServer() {
+        running_ = false;
+        ::shutdown(listenFd_, SHUT_RDWR);
+        ::close(listenFd_);
+        acceptor_.join();
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int fd : clients_) ::shutdown(fd, SHUT_RDWR);
+        }
+        for (auto& connection : connections_) connection.join();
+    }
+    
+    FixtureServer(const FixtureServer&) = delete;
+    FixtureServer& operator=(const FixtureServer&) = delete;
+    
+    void add(const std::string& path, std::string body) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pages_[path] = std::make_shared<const std::string>(std::move(body));
+    }
+    
+    std::string url(const std::string& path) const {
+        return "http://127.0.0.1:" + std::to_string(port_) + path;
+    }
+    
+    size_t requests() const { return requests_; }
+
+private:
+    void acceptLoop() {
+        while (running_) {
+            int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (!running_) break;
+                continue;
+            }
+            int noDelay = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            
+            std::lock_guard<std::mutex> lock(mutex_);
+            clients_.push_back(fd);
+            connections_.emplace_back([this, fd] { serve(fd); });
+        }
+    }
+    
+    void serve(int fd) {
+        std::string buffer;
+        char chunk[8192];
+        
+        for (;;) {
+            size_t end;
+            while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (received <= 0) {
+                    disconnect(fd);
+                    return;
+                }
+                buffer.append(chunk, static_cast<size_t>(received));
+            }
+            
+            std::string requestLine = buffer.substr(0, buffer.find("\r\n"));
+            buffer.erase(0, end + 4);
+            ++requests_;
+            
+            size_t pathStart = requestLine.find(' ') + 1;
+            std::string path = requestLine.substr(pathStart, requestLine.find(' ', pathStart) - pathStart);
+            
+            std::shared_ptr<const std::string> body;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = pages_.find(path);
+                if (requestLine.compare(0, 4, "GET ") == 0 && it != pages_.end()) body = it->second;
+            }
+            
+            static const std::string notFound = "Not Found";
+            const std::string& content = body ? *body : notFound;
+            std::string header = std::string(body ? "HTTP/1.1 200 OK" : "HTTP/1.1 404 Not Found") +
+                                 "\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: " +
+                                 std::to_string(content.size()) + "\r\n\r\n";
+            if (!sendAll(fd, header) || !sendAll(fd, content)) {
+                disconnect(fd);
+                return;
+            }
+        }
+    }
+    
+    static bool sendAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+    
+    void disconnect(int fd) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        clients_.erase(std::remove(clients_.begin(), clients_.end(), fd), clients_.end());
+        ::close(fd);
+    }
+};
@@ -0,0 +1,552 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <curl/curl.h>
+#include <unistd.h>
+
+#include "batch_runner.hpp"
+#include "fixture_server.hpp"
+#include "html_parser.hpp"
+#include "http_client.hpp"
+#include "logger.hpp"
+#include "manga_scraper.hpp"
+#include "stream_extractor.hpp"
+#include "string_utils.hpp"
+#include "url_utils.hpp"
+
+#ifndef LINKEX_BENCH_FIXTURES
+#define LINKEX_BENCH_FIXTURES "bench/fixtures"
+#endif
+
+// ============================================================================
+// BENCHMARK HELPERS
+// ============================================================================
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const std::string& name, size_t items, double seconds) {
+    std::cout << "  " << std::left << std::setw(44) << name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(3) << seconds * 1000.0 << " ms"
+              << std::setw(14) << std::setprecision(0) << items / seconds << " items/s" << std::endl;
+}
+
+// Mean per run over `runs` repetitions of an operation on `items` items
+void reportRuns(const std::string& name, size_t items, size_t runs, double seconds) {
+    report(name, items, seconds / static_cast<double>(runs));
+}
+
+void reportLatency(const std::string& name, std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double fraction) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()))] * 1000.0;
+    };
+    std::cout << "  " << std::left << std::setw(44) << name << std::right << std::fixed << std::setprecision(3)
+              << "  p50 " << at(0.50) << " ms  p95 " << at(0.95) << " ms  max " << samples.back() * 1000.0
+              << " ms" << std::endl;
+}
+
+// Mean per run when `threads` threads each repeat `run` `runs` times at once
+template <typename Run>
+double parallelSeconds(size_t threads, size_t runs, Run run) {
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back([&] {
+            for (size_t i = 0; i < runs; ++i) run();
+        });
+    }
+    for (auto& thread : pool) thread.join();
+    return secondsSince(start) / static_cast<double>(threads);
+}
+
+// Silences std::cout (and with it Logger) while scrapers run. The logger writes
+// from its own thread, so it is drained before each swap of the stream buffer.
+class QuietOutput {
+private:
+    std::ostringstream sink_;
+    std::streambuf* saved_;
+
+public:
+    QuietOutput() : saved_((Logger::flush(), std::cout.rdbuf(sink_.rdbuf()))) {}
+    
+    ~QuietOutput() {
+        Logger::flush();
+        std::cout.rdbuf(saved_);
+    }
+};
+
+// A series page in the layout the default selectors expect
+std::string syntheticSeriesPage(size_t chapters) {
+    std::string html;
+    html.reserve(chapters * 160 + 1024);
+    html += "<!DOCTYPE html><html><head><title>Synthetic Series</title></head><body>";
+    html += "<div id=\"manga-info-rightColumn\"><h1 class=\"big-fat-titles\">Synthetic Series ";
+    html += std::to_string(chapters);
+    html += "</h1><div class=\"white-font\">Generated for linkex benchmarks &amp; profiling.</div></div>";
+    html += "<ul id=\"chapters-list\">";
+    for (size_t i = chapters; i > 0; --i) {
+        std::string number = std::to_string(i);
+        html += "<li><a href=\"/title/Synthetic-Series/chapter/" + number + "/1\" class=\"chplinks\">";
+        html += "<span>Chapter " + number + "</span><span class=\"date\">2024-01-01</span></a></li>";
+    }
+    html += "</ul><div id=\"footer\">footer</div></body></html>";
+    return html;
+}
+
+// The same page inside the scripts, ads and comments a real site wraps around it
+std::string clutteredSeriesPage(size_t chapters) {
+    std::string page = syntheticSeriesPage(chapters);
+    std::string clutter;
+    for (size_t i = 0; i < 200; ++i) {
+        std::string n = std::to_string(i);
+        clutter += "<script>window.slot" + n + " = {id: \"chapters-list\", html: \"<div id='x'></div>\"};</script>";
+        clutter += "<!-- ad " + n + " <ul id=\"chapters-list\"> -->";
+        clutter += "<div class=\"ad\"><a href=\"/promo/" + n + "\"><img src=\"/ads/" + n + ".png\"></a>";
+        clutter += "<p>Sponsored content " + n + " with some text to skip over</p></div>";
+    }
+    page.insert(page.find("<body>") + 6, clutter);
+    page.insert(page.find("</body>"), clutter);
+    return page;
+}
+
+// Chapter URLs across several series, with some decimal chapters, in random order
+std::vector<std::string> syntheticChapterUrls(size_t count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> urls;
+    urls.reserve(count);
+    
+    size_t series = std::max<size_t>(1, count / 2000);
+    for (size_t i = 0; i < count; ++i) {
+        size_t chapter = i / series + 1;
+        std::string number = std::to_string(chapter);
+        if (rng() % 20 == 0) number += ".5";
+        urls.push_back("https://demonicscans.org/title/Series-" + std::to_string(i % series) +
+                       "/chapter/" + number + "/1");
+    }
+    std::shuffle(urls.begin(), urls.end(), rng);
+    return urls;
+}
+
+// The comparator StringUtils::naturalSort used before sort keys: builds a
+// regex and tokenizes both strings on every comparison
+bool legacyNaturalSort(const std::string& a, const std::string& b) {
+    auto tokens = [](const std::string& str) {
+        std::vector<std::string> result;
+        std::regex tokenRegex(R"((\d+|\D+))");
+        for (auto it = std::sregex_iterator(str.begin(), str.end(), tokenRegex); it != std::sregex_iterator(); ++it) {
+            result.push_back(it->str());
+        }
+        return result;
+    };
+    
+    auto aTokens = tokens(a);
+    auto bTokens = tokens(b);
+    size_t minSize = std::min(aTokens.size(), bTokens.size());
+    for (size_t i = 0; i < minSize; ++i) {
+        bool aIsNumber = std::all_of(aTokens[i].begin(), aTokens[i].end(), ::isdigit);
+        bool bIsNumber = std::all_of(bTokens[i].begin(), bTokens[i].end(), ::isdigit);
+        if (aIsNumber && bIsNumber) {
+            int aNum = std::stoi(aTokens[i]);
+            int bNum = std::stoi(bTokens[i]);
+            if (aNum != bNum) return aNum < bNum;
+        } else {
+            std::string aLower = StringUtils::toLower(aTokens[i]);
+            std::string bLower = StringUtils::toLower(bTokens[i]);
+            if (aLower != bLower) return aLower < bLower;
+        }
+    }
+    return aTokens.size() < bTokens.size();
+}
+
+} // namespace
+
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+void benchNaturalSort(size_t count) {
+    std::cout << "\nNatural sort of " << count << " synthetic chapter URLs" << std::endl;
+    const std::vector<std::string> input = syntheticChapterUrls(count, 42);
+    
+    // The regex comparator needs minutes at 100k; time it on a prefix instead
+    size_t legacyCount = std::min<size_t>(count, 10000);
+    std::vector<std::string> legacy(input.begin(), input.begin() + legacyCount);
+    auto start = Clock::now();
+    std::sort(legacy.begin(), legacy.end(), legacyNaturalSort);
+    report("regex comparator, " + std::to_string(legacyCount) + " (before)", legacyCount, secondsSince(start));
+    
+    std::vector<std::string> legacyAfter(input.begin(), input.begin() + legacyCount);
+    start = Clock::now();
+    StringUtils::sortNaturally(legacyAfter);
+    report("sort keys, " + std::to_string(legacyCount) + " (after)", legacyCount, secondsSince(start));
+    
+    std::vector<std::string> comparator = input;
+    start = Clock::now();
+    std::sort(comparator.begin(), comparator.end(), StringUtils::naturalSort);
+    report("StringUtils::naturalSort", count, secondsSince(start));
+    
+    start = Clock::now();
+    NaturalSortKeys keys(input);
+    report("NaturalSortKeys build", count, secondsSince(start));
+    
+    start = Clock::now();
+    std::vector<uint32_t> order = keys.order();
+    (void)order;
+    report("NaturalSortKeys sort", count, secondsSince(start));
+    
+    std::vector<std::string> sorted = input;
+    start = Clock::now();
+    StringUtils::sortNaturally(sorted);
+    report("StringUtils::sortNaturally", count, secondsSince(start));
+    
+    if (sorted != comparator) {
+        std::cout << "  WARNING: sortNaturally and naturalSort disagree" << std::endl;
+    }
+}
+
+// Per-page stages of a scrape, measured on synthetic pages of `chapters` chapters
+void benchPage(size_t chapters) {
+    std::cout << "\nPage with " << chapters << " chapters" << std::endl;
+    const std::string html = syntheticSeriesPage(chapters);
+    const PageSelectors& selectors = *PageSelectors::defaults();
+    size_t runs = std::clamp<size_t>(200000 / chapters, 1, 200);
+    
+    std::vector<const CSSSelector*> query;
+    for (const auto& selector : selectors.chapterLinks) query.push_back(&selector);
+    query.push_back(&selectors.title);
+    
+    // Gumbo's own malloc/free against the per-thread arena HTMLParser uses
+    auto mallocParse = [&] {
+        GumboOutput* output = gumbo_parse_with_options(&kGumboDefaultOptions, html.data(), html.size());
+        gumbo_destroy_output(&kGumboDefaultOptions, output);
+    };
+    auto arenaParse = [&] { HTMLParser parser(html); };
+    
+    auto start = Clock::now();
+    for (size_t run = 0; run < runs; ++run) mallocParse();
+    reportRuns("Gumbo parse, malloc/free", chapters, runs, secondsSince(start));
+    
+    start = Clock::now();
+    for (size_t run = 0; run < runs; ++run) arenaParse();
+    reportRuns("Gumbo parse, arena", chapters, runs, secondsSince(start));
+    
+    size_t threads = std::max(2u, std::thread::hardware_concurrency());
+    size_t threadRuns = std::max<size_t>(1, runs / 4);
+    reportRuns("Gumbo parse, malloc/free, " + std::to_string(threads) + " threads", chapters, threadRuns,
+               parallelSeconds(threads, threadRuns, mallocParse));
+    reportRuns("Gumbo parse, arena, " + std::to_string(threads) + " threads", chapters, threadRuns,
+               parallelSeconds(threads, threadRuns, arenaParse));
+    
+    size_t found = 0;
+    start = Clock::now();
+    for (size_t run = 0; run < runs; ++run) {
+        HTMLParser parser(html);
+        found = parser.select(query).front().size();
+    }
+    reportRuns("HTMLParser parse + select", chapters, runs, secondsSince(start));
+    if (found != chapters) {
+        std::cout << "  WARNING: selected " << found << " of " << chapters << " chapter links" << std::endl;
+    }
+    
+    // Scoped parses: only the containers the selectors reach go to Gumbo
+    const std::string cluttered = clutteredSeriesPage(chapters);
+    for (const std::string* page : {&html, &cluttered}) {
+        std::string label = page == &html ? "" : ", cluttered page";
+        if (page == &cluttered) {
+            start = Clock::now();
+            for (size_t run = 0; run < runs; ++run) {
+                HTMLParser parser(*page);
+                found = parser.select(query).front().size();
+            }
+            reportRuns("HTMLParser parse + select" + label, chapters, runs, secondsSince(start));
+        }
+        
+        bool scoped = false;
+        start = Clock::now();
+        for (size_t run = 0; run < runs; ++run) {
+            HTMLParser parser(*page, selectors.scopeIds);
+            found = parser.select(query).front().size();
+            scoped = parser.scoped();
+        }
+        reportRuns(std::string("HTMLParser scoped parse + select (") + PageScanner::instructionSet() + ")" + label,
+                   chapters, runs, secondsSince(start));
+        if (!scoped || found != chapters) {
+            std::cout << "  WARNING: scoped parse " << (scoped ? "" : "fell back, ") << "selected " << found
+                      << " of " << chapters << " chapter links" << std::endl;
+        }
+    }
+    
+    HTMLParser parser(html);
+    start = Clock::now();
+    std::vector<HTMLElement> elements;
+    for (size_t run = 0; run < runs; ++run) {
+        elements = parser.select(query).front();
+    }
+    reportRuns("HTMLParser select only", chapters, runs, secondsSince(start));
+    
+    start = Clock::now();
+    for (size_t run = 0; run < runs; ++run) {
+        ChapterStreamExtractor extractor("chapters-list", "manga-info-rightColumn", [](const std::string&) {});
+        for (size_t offset = 0; offset < html.size(); offset += 16384) {
+            if (!extractor.feed(html.data() + offset, std::min<size_t>(16384, html.size() - offset))) break;
+        }
+    }
+    reportRuns("ChapterStreamExtractor (16 KiB chunks)", chapters, runs, secondsSince(start));
+    
+    size_t bytes = 0;
+    start = Clock::now();
+    for (size_t run = 0; run < runs; ++run) {
+        for (const auto& element : elements) bytes += element.getAttribute("href").size();
+    }
+    reportRuns("HTMLElement::getAttribute (copy)", chapters, runs, secondsSince(start));
+    
+    start = Clock::now();
+    for (size_t run = 0; run < runs; ++run) {
+        for (const auto& element : elements) bytes -= element.attribute("href").size();
+    }
+    reportRuns("HTMLElement::attribute (view)", chapters, runs, secondsSince(start));
+    if (bytes != 0) {
+        std::cout << "  WARNING: attribute and getAttribute disagree" << std::endl;
+    }
+    
+    std::vector<std::string_view> hrefs;
+    hrefs.reserve(elements.size());
+    for (const auto& element : elements) hrefs.push_back(element.attribute("href"));
+    
+    std::vector<std::string> links;
+    start = Clock::now();
+    for (size_t run = 0; run < runs; ++run) {
+        links.clear();
+        for (const auto& href : hrefs) links.push_back(URLUtils::join("https://demonicscans.org", href));
+    }
+    reportRuns("URLUtils::join", chapters, runs, secondsSince(start));
+    
+    start = Clock::now();
+    for (size_t run = 0; run < runs; ++run) {
+        links.clear();
+        for (const auto& href : hrefs) {
+            links.push_back(URLUtils::normalize(URLUtils::resolve("https://demonicscans.org/manga/Bench", href)));
+        }
+    }
+    reportRuns("URLUtils::resolve + normalize", chapters, runs, secondsSince(start));
+    
+    start = Clock::now();
+    for (size_t run = 0; run < runs; ++run) {
+        std::vector<std::string> sorted = links;
+        StringUtils::sortNaturally(sorted);
+    }
+    reportRuns("StringUtils::sortNaturally", chapters, runs, secondsSince(start));
+    
+    std::vector<std::string> titles;
+    titles.reserve(chapters);
+    for (size_t i = 0; i < chapters; ++i) {
+        titles.push_back("  Chapter " + std::to_string(i) + ": The Return of the Mount Hua Sect!?  ");
+    }
+    size_t titleRuns = std::max<size_t>(1, runs / 10);
+    start = Clock::now();
+    for (size_t run = 0; run < titleRuns; ++run) {
+        for (const auto& title : titles) {
+            std::string filename = StringUtils::createSafeFilename(title);
+            (void)filename;
+        }
+    }
+    reportRuns("StringUtils::createSafeFilename", chapters, titleRuns, secondsSince(start));
+}
+
+// Full scrapes over HTTP against the in-process fixture server
+void benchEndToEnd(const std::vector<size_t>& sizes, size_t iterations) {
+    std::cout << "\nEnd to end against a local fixture server (" << iterations << " iterations)" << std::endl;
+    
+    FixtureServer server;
+    std::vector<std::pair<std::string, std::string>> pages; // Label, URL
+    for (size_t chapters : sizes) {
+        std::string path = "/manga/Synthetic-" + std::to_string(chapters);
+        server.add(path, syntheticSeriesPage(chapters));
+        pages.emplace_back(std::to_string(chapters) + " chapters", server.url(path));
+    }
+    
+    // Recorded pages are served verbatim
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(LINKEX_BENCH_FIXTURES, ec)) {
+        if (entry.path().extension() != ".html") continue;
+        std::ifstream file(entry.path(), std::ios::binary);
+        std::string body((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::string path = "/manga/" + entry.path().stem().string();
+        server.add(path, std::move(body));
+        pages.emplace_back("recorded " + entry.path().filename().string(), server.url(path));
+    }
+    
+    std::filesystem::path outputDir = std::filesystem::temp_directory_path() /
+                                      ("linkex_bench_" + std::to_string(::getpid()));
+    std::filesystem::create_directories(outputDir);
+    
+    // Unpaced: the limiter would otherwise hold the benchmark to 10 requests per second
+    HTTPClientOptions clientOptions;
+    clientOptions.rateLimit.requestsPerSecond = 0;
+    clientOptions.rateLimit.initialConcurrency = 16;
+    clientOptions.rateLimit.maxConcurrency = 64;
+    
+    ScrapeOptions options;
+    options.showProgress = false;
+    options.outputDir = outputDir.string();
+    
+    for (const auto& page : pages) {
+        for (bool streaming : {false, true}) {
+            HTTPClient client(clientOptions);
+            options.streaming = streaming;
+            std::vector<double> scrapes;
+            std::vector<double> saves;
+            size_t failures = 0;
+            
+            for (size_t i = 0; i < iterations; ++i) {
+                QuietOutput quiet;
+                MangaScraper scraper(page.second, client, options);
+                auto start = Clock::now();
+                if (!scraper.scrape()) {
+                    ++failures;
+                    continue;
+                }
+                scrapes.push_back(secondsSince(start));
+                
+                start = Clock::now();
+                if (scraper.saveToFile()) saves.push_back(secondsSince(start));
+            }
+            
+            std::string label = page.first + (streaming ? ", stream" : ", DOM");
+            if (scrapes.empty()) {
+                std::cout << "  " << label << ": every scrape failed" << std::endl;
+                continue;
+            }
+            reportLatency("scrape, " + label, scrapes);
+            if (!streaming && !saves.empty()) reportLatency("saveToFile, " + page.first, saves);
+            if (failures > 0) std::cout << "  WARNING: " << failures << " scrapes failed" << std::endl;
+        }
+    }
+    
+    // Throughput of the batch runner over many series on one host
+    std::vector<std::string> urls;
+    std::string batchPage = syntheticSeriesPage(1000);
+    for (size_t i = 0; i < 64; ++i) {
+        std::string path = "/batch/Series-" + std::to_string(i);
+        server.add(path, batchPage);
+        urls.push_back(server.url(path));
+    }
+    
+    BatchRunner runner(urls, 8, options, clientOptions);
+    auto start = Clock::now();
+    {
+        QuietOutput quiet;
+        runner.run();
+    }
+    double seconds = secondsSince(start);
+    report("batch, 64 series x 1000 chapters, 8 jobs", urls.size(), seconds);
+    if (runner.failureCount() > 0) {
+        std::cout << "  WARNING: " << runner.failureCount() << " batch jobs failed" << std::endl;
+    }
+    
+    std::filesystem::remove_all(outputDir, ec);
+}
+
+// Many transfers at once on the client's event loop thread
+void benchAsyncFetch(size_t transfers) {
+    FixtureServer server;
+    server.add("/page", syntheticSeriesPage(100));
+    
+    HTTPClientOptions clientOptions;
+    clientOptions.rateLimit.requestsPerSecond = 0;
+    clientOptions.rateLimit.initialConcurrency = transfers;
+    clientOptions.rateLimit.maxConcurrency = transfers;
+    HTTPClient client(clientOptions);
+    
+    std::vector<std::future<HTTPResponse>> responses;
+    responses.reserve(transfers);
+    size_t failures = 0;
+    auto start = Clock::now();
+    {
+        QuietOutput quiet;
+        for (size_t i = 0; i < transfers; ++i) {
+            responses.push_back(client.getFuture(server.url("/page")));
+        }
+        for (auto& response : responses) {
+            if (!response.get().success) ++failures;
+        }
+    }
+    report("HTTPClient::getFuture, " + std::to_string(transfers) + " at once (peak " +
+           std::to_string(client.stats().peakInFlight) + ")", transfers, secondsSince(start));
+    if (failures > 0) std::cout << "  WARNING: " << failures << " transfers failed" << std::endl;
+}
+
+std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        size_t size = std::strtoul(item.c_str(), nullptr, 10);
+        if (size > 0) sizes.push_back(size);
+    }
+    return sizes;
+}
+
+int main(int argc, char* argv[]) {
+    size_t sortCount = 100000;
+    std::vector<size_t> sizes = {100, 1000, 10000, 50000};
+    size_t iterations = 20;
+    bool endToEnd = true;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sort" && hasValue) {
+            sortCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--sizes" && hasValue) {
+            sizes = parseSizes(argv[++i]);
+        } else if (arg == "--iterations" && hasValue) {
+            iterations = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--no-e2e") {
+            endToEnd = false;
+        } else {
+            sortCount = std::strtoul(arg.c_str(), nullptr, 10);
+            if (sortCount == 0) {
+                std::cerr << "Usage: linkex_bench [--sort N] [--sizes 100,1000,...] [--iterations N] [--no-e2e]"
+                          << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (sortCount == 0 || sizes.empty() || iterations == 0) {
+        std::cerr << "Counts, sizes and iterations must be positive" << std::endl;
+        return 1;
+    }
+    
+    std::cout << "linkex benchmarks" << std::endl;
+    benchNaturalSort(sortCount);
+    for (size_t chapters : sizes) {
+        benchPage(chapters);
+    }
+    
+    if (endToEnd) {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        benchEndToEnd(sizes, iterations);
+        benchAsyncFetch(1000);
+        curl_global_cleanup();
+    }
+    return 0;
+}
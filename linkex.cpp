@@ -1,620 +1,590 @@
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <vector>
 #include <string>
-#include <algorithm>
-#include <regex>
-#include <cctype>
-#include <cstring>
-#include <memory>
+#include <filesystem>
 #include <stdexcept>
-#include <sstream>
-#include <chrono>
-#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <unistd.h>
 #include <curl/curl.h>
-#include <gumbo.h>
-#include <iomanip>
+
+#include "batch_runner.hpp"
+#include "html_parser.hpp"
+#include "http_client.hpp"
+#include "job_server.hpp"
+#include "logger.hpp"
+#include "manga_scraper.hpp"
+#include "metrics.hpp"
+#include "output_sink.hpp"
+#include "watch_scheduler.hpp"
+
 // ============================================================================
-// UTILITY CLASSES AND FUNCTIONS
+// MAIN FUNCTION
 // ============================================================================
 
-class Logger {
-public:
-    enum Level { INFO, WARNING, ERROR, SUCCESS };
-    
-    static void log(Level level, const std::string& message) {
-        std::string prefix;
-        std::string color;
-        
-        switch (level) {
-            case INFO:    prefix = "[INFO]"; color = "\033[36m"; break;  // Cyan
-            case WARNING: prefix = "[WARN]"; color = "\033[33m"; break;  // Yellow
-            case ERROR:   prefix = "[ERROR]"; color = "\033[31m"; break; // Red
-            case SUCCESS: prefix = "[SUCCESS]"; color = "\033[32m"; break; // Green
-        }
-        
-        std::cout << color << prefix << "\033[0m " << message << std::endl;
-    }
-    
-    static void info(const std::string& msg) { log(INFO, msg); }
-    static void warning(const std::string& msg) { log(WARNING, msg); }
-    static void error(const std::string& msg) { log(ERROR, msg); }
-    static void success(const std::string& msg) { log(SUCCESS, msg); }
-};
+void printBanner() {
+    std::cout << "\033[1;36m" << std::endl;
+    std::cout << "██╗     ██╗███╗   ██╗██╗  ██╗███████╗██╗  ██╗" << std::endl;
+    std::cout << "██║     ██║████╗  ██║██║ ██╔╝██╔════╝╚██╗██╔╝" << std::endl;
+    std::cout << "██║     ██║██╔██╗ ██║█████╔╝ █████╗   ╚███╔╝ " << std::endl;
+    std::cout << "██║     ██║██║╚██╗██║██╔═██╗ ██╔══╝   ██╔██╗ " << std::endl;
+    std::cout << "███████╗██║██║ ╚████║██║  ██╗███████╗██╔╝ ██╗" << std::endl;
+    std::cout << "╚══════╝╚═╝╚═╝  ╚═══╝╚═╝  ╚═╝╚══════╝╚═╝  ╚═╝" << std::endl;
+    std::cout << "\033[0m" << std::endl;
+    std::cout << "\033[1;33mAdvanced Manga Chapter Link Extractor v2.0\033[0m" << std::endl;
+    std::cout << "\033[90mBuilt with C++17 | Powered by libcurl & gumbo-parser\033[0m" << std::endl;
+    std::cout << std::string(60, '-') << std::endl << std::endl;
+}
 
-class ProgressBar {
-private:
-    size_t total_;
-    size_t current_;
-    size_t bar_width_;
-    std::string description_;
-    
-public:
-    ProgressBar(size_t total, const std::string& description = "Progress", size_t bar_width = 50)
-        : total_(total), current_(0), bar_width_(bar_width), description_(description) {}
-    
-    void update(size_t current) {
-        current_ = current;
-        display();
-    }
-    
-    void increment() {
-        update(current_ + 1);
-    }
-    
-private:
-    void display() {
-        float progress = static_cast<float>(current_) / total_;
-        size_t filled = static_cast<size_t>(progress * bar_width_);
-        
-        std::cout << "\r\033[36m" << description_ << "\033[0m [";
-        for (size_t i = 0; i < bar_width_; ++i) {
-            if (i < filled) {
-                std::cout << "\033[32m█\033[0m";  // Green filled
+void printUsage() {
+    std::cout << "\033[1mUsage:\033[0m linkex <URL>" << std::endl;
+    std::cout << "       linkex --batch <file|-> [--jobs N] [--output-dir DIR]" << std::endl;
+    std::cout << "       linkex --serve <PORT|HOST:PORT|SOCKET> [--jobs N]" << std::endl;
+    std::cout << "       linkex --watch <file|-> [--min-interval D] [--max-interval D] [--output-dir DIR]" << std::endl;
+    std::cout << "\033[1mExample:\033[0m linkex https://demonicscans.org/manga/The-Beginning-After-the-End" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\033[1mOptions:\033[0m" << std::endl;
+    std::cout << "  --batch <file>       Scrape every URL listed in <file> (one per line, '-' for stdin)" << std::endl;
+    std::cout << "  --jobs <N>           Maximum concurrent scrape jobs in batch, serve or watch mode (default: 8)" << std::endl;
+    std::cout << "  --serve <ADDR>       Take scrape jobs as JSON over HTTP on a localhost port or Unix socket" << std::endl;
+    std::cout << "  --watch <file>       Keep re-checking the listed series and report only new chapters" << std::endl;
+    std::cout << "  --min-interval <D>   Shortest time between checks of one series, e.g. 90s, 10m (default: 10m)" << std::endl;
+    std::cout << "  --max-interval <D>   Longest time between checks of a quiet series (default: 24h)" << std::endl;
+    std::cout << "  --output-dir <DIR>   Directory for chapter files and the batch summary" << std::endl;
+    std::cout << "  --stream             Extract links while downloading and stop after the chapter list" << std::endl;
+    std::cout << "  --incremental        Only save chapters added/removed since the last run (keeps a .index file)" << std::endl;
+    std::cout << "  --stop-after-known <N> With --stream --incremental, stop after N known chapters in a row, 0 = never (default: 3)" << std::endl;
+    std::cout << "  --chapter-selector   CSS selector for chapter links (repeat to add fallbacks, in order)" << std::endl;
+    std::cout << "  --title-selector     CSS selector for the manga title" << std::endl;
+    std::cout << "  --crawl-pages        Fetch every chapter page and write per-chapter image manifests" << std::endl;
+    std::cout << "  --crawl-jobs <N>     Concurrent chapter page fetches per series (default: 8)" << std::endl;
+    std::cout << "  --image-selector     CSS selector for page images when crawling (default: img)" << std::endl;
+    std::cout << "  --rate <N>           Requests per second per host, 0 = unpaced (default: 10)" << std::endl;
+    std::cout << "  --max-concurrency <N> Upper bound for the adaptive per-host concurrency (default: 16)" << std::endl;
+    std::cout << "  --retries <N>        Retries for transient failures, with jittered backoff (default: 3)" << std::endl;
+    std::cout << "  --hedge              Race a duplicate request when one outlives the recent p95 latency" << std::endl;
+    std::cout << "  --metrics-json <FILE> Write per-request network timings, phase timings and peak RSS as JSON" << std::endl;
+    std::cout << "  --metrics-prom <FILE> Write the same metrics for the Prometheus textfile collector" << std::endl;
+    std::cout << "  --cache-dir <DIR>    Cache pages on disk and revalidate them with ETag/Last-Modified" << std::endl;
+    std::cout << "  --record <FILE>      Append every HTTP response to a traffic archive" << std::endl;
+    std::cout << "  --replay <FILE>      Serve HTTP responses from a traffic archive, never the network" << std::endl;
+    std::cout << "  --replay-latency     Wait out the recorded latencies while replaying" << std::endl;
+    std::cout << "  --format <FMT>       Output format: txt, jsonl, tsv or urls (default: txt, jsonl for --watch)" << std::endl;
+    std::cout << "  --stdout             Write chapters to stdout instead of a file (messages go to stderr)" << std::endl;
+    std::cout << "  --unsorted           Emit each chapter as soon as it is extracted, in page order (not for txt)" << std::endl;
+    std::cout << "  --log-level <LEVEL>  Only log messages at LEVEL or above: info, warn or error (default: info)" << std::endl;
+    std::cout << "  --log-json           Log one JSON object per line (time, level, context, message)" << std::endl;
+    std::cout << "  --no-color           Plain output even on a terminal (also NO_COLOR, or when not a terminal)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\033[1mFeatures:\033[0m" << std::endl;
+    std::cout << "  • Natural chapter sorting (1, 2, 10 instead of 1, 10, 2)" << std::endl;
+    std::cout << "  • Intelligent URL handling (relative & absolute)" << std::endl;
+    std::cout << "  • Comprehensive error handling & logging" << std::endl;
+    std::cout << "  • Progress tracking with visual indicators" << std::endl;
+    std::cout << "  • Safe filename generation" << std::endl;
+    std::cout << "  • Metadata-rich output files" << std::endl;
+    std::cout << "  • Concurrent batch scraping with aggregate summary" << std::endl;
+}
+
+struct CommandLine {
+    std::string url;
+    std::string batchFile;
+    std::string serve;       // Listen address for --serve
+    std::string watchFile;
+    double minInterval = 600.0;
+    double maxInterval = 86400.0;
+    size_t jobs = 8;
+    std::string outputDir;
+    bool streaming = false;
+    bool incremental = false;
+    std::vector<std::string> chapterSelectors;
+    std::string titleSelector;
+    std::string cacheDir;
+    std::string recordPath;
+    std::string replayPath;
+    bool replayLatency = false;
+    bool crawlPages = false;
+    size_t crawlJobs = 8;
+    std::string imageSelector;
+    double rate = 10.0;
+    size_t maxConcurrency = 16;
+    size_t retries = 3;
+    size_t stopAfterKnown = 3;
+    bool hedge = false;
+    std::string metricsJson;
+    std::string metricsProm;
+    OutputFormat format = OutputFormat::Text;
+    bool formatGiven = false;
+    bool toStdout = false;
+    bool unsorted = false;
+    Logger::Options log;
+    bool noColor = false;
+    std::shared_ptr<Metrics> metrics; // Set when either metrics file is requested
+    
+    bool parse(int argc, char* argv[], std::string& error) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            
+            auto value = [&](std::string& out) {
+                if (i + 1 >= argc) {
+                    error = "Missing value for " + arg;
+                    return false;
+                }
+                out = argv[++i];
+                return true;
+            };
+            
+            if (arg == "--batch") {
+                if (!value(batchFile)) return false;
+            } else if (arg == "--serve") {
+                if (!value(serve)) return false;
+            } else if (arg == "--watch") {
+                if (!value(watchFile)) return false;
+            } else if (arg == "--min-interval" || arg == "--max-interval") {
+                std::string durationValue;
+                if (!value(durationValue)) return false;
+                if (!WatchScheduler::parseDuration(durationValue, arg == "--min-interval" ? minInterval : maxInterval)) {
+                    error = "Invalid value for " + arg + ": " + durationValue;
+                    return false;
+                }
+            } else if (arg == "--rate") {
+                std::string rateValue;
+                if (!value(rateValue)) return false;
+                try {
+                    rate = std::stod(rateValue);
+                } catch (const std::exception&) {
+                    rate = -1.0;
+                }
+                if (!(rate >= 0.0)) {
+                    error = "Invalid value for --rate: " + rateValue;
+                    return false;
+                }
+            } else if (arg == "--jobs" || arg == "--crawl-jobs" || arg == "--max-concurrency") {
+                std::string countValue;
+                if (!value(countValue)) return false;
+                size_t count = 0;
+                try {
+                    count = std::stoul(countValue);
+                } catch (const std::exception&) {
+                    count = 0;
+                }
+                if (count == 0) {
+                    error = "Invalid value for " + arg + ": " + countValue;
+                    return false;
+                }
+                (arg == "--jobs" ? jobs : arg == "--crawl-jobs" ? crawlJobs : maxConcurrency) = count;
+            } else if (arg == "--output-dir") {
+                if (!value(outputDir)) return false;
+            } else if (arg == "--stream") {
+                streaming = true;
+            } else if (arg == "--incremental") {
+                incremental = true;
+            } else if (arg == "--chapter-selector") {
+                chapterSelectors.emplace_back();
+                if (!value(chapterSelectors.back())) return false;
+            } else if (arg == "--title-selector") {
+                if (!value(titleSelector)) return false;
+            } else if (arg == "--retries" || arg == "--stop-after-known") {
+                // Unlike the counts above, 0 is allowed
+                std::string countValue;
+                if (!value(countValue)) return false;
+                try {
+                    size_t parsed = 0;
+                    (arg == "--retries" ? retries : stopAfterKnown) = std::stoul(countValue, &parsed);
+                    if (parsed != countValue.size() || countValue.front() == '-') throw std::invalid_argument(countValue);
+                } catch (const std::exception&) {
+                    error = "Invalid value for " + arg + ": " + countValue;
+                    return false;
+                }
+            } else if (arg == "--hedge") {
+                hedge = true;
+            } else if (arg == "--crawl-pages") {
+                crawlPages = true;
+            } else if (arg == "--image-selector") {
+                if (!value(imageSelector)) return false;
+            } else if (arg == "--metrics-json") {
+                if (!value(metricsJson)) return false;
+            } else if (arg == "--metrics-prom") {
+                if (!value(metricsProm)) return false;
+            } else if (arg == "--cache-dir") {
+                if (!value(cacheDir)) return false;
+            } else if (arg == "--format") {
+                std::string formatValue;
+                if (!value(formatValue)) return false;
+                if (!ChapterSink::parseFormat(formatValue, format)) {
+                    error = "Invalid value for --format: " + formatValue;
+                    return false;
+                }
+                formatGiven = true;
+            } else if (arg == "--record") {
+                if (!value(recordPath)) return false;
+            } else if (arg == "--replay") {
+                if (!value(replayPath)) return false;
+            } else if (arg == "--replay-latency") {
+                replayLatency = true;
+            } else if (arg == "--stdout") {
+                toStdout = true;
+            } else if (arg == "--unsorted") {
+                unsorted = true;
+            } else if (arg == "--log-level") {
+                std::string levelValue;
+                if (!value(levelValue)) return false;
+                if (!Logger::parseLevel(levelValue, log.minimum)) {
+                    error = "Invalid value for --log-level: " + levelValue;
+                    return false;
+                }
+            } else if (arg == "--log-json") {
+                log.format = Logger::Format::Json;
+            } else if (arg == "--no-color") {
+                noColor = true;
+            } else if (!arg.empty() && arg.front() == '-' && arg != "-") {
+                error = "Unknown option: " + arg;
+                return false;
+            } else if (url.empty()) {
+                url = arg;
             } else {
-                std::cout << "\033[90m░\033[0m";  // Gray empty
+                error = "Unexpected argument: " + arg;
+                return false;
             }
         }
-        std::cout << "] " << current_ << "/" << total_ 
-                  << " (" << static_cast<int>(progress * 100) << "%)";
-        std::cout.flush();
         
-        if (current_ == total_) {
-            std::cout << std::endl;
+        if (!serve.empty()) {
+            if (!url.empty() || !batchFile.empty() || !watchFile.empty() || toStdout) {
+                error = "--serve takes jobs over its API, not a URL, --batch, --watch or --stdout";
+                return false;
+            }
+        } else if (!watchFile.empty()) {
+            if (!url.empty() || !batchFile.empty()) {
+                error = "--watch takes its series from the list, not a URL or --batch";
+                return false;
+            }
+            if (unsorted) {
+                error = "--watch reports each check's new chapters at once, --unsorted does not apply";
+                return false;
+            }
+            if (minInterval > maxInterval) {
+                error = "--min-interval is longer than --max-interval";
+                return false;
+            }
+            if (!formatGiven) format = OutputFormat::JsonLines;
+        } else if (url.empty() == batchFile.empty()) {
+            error = batchFile.empty() ? "No URL provided" : "Use either a URL or --batch, not both";
+            return false;
+        }
+        if (!recordPath.empty() && !replayPath.empty()) {
+            error = "Use either --record or --replay, not both";
+            return false;
+        }
+        if (replayLatency && replayPath.empty()) {
+            error = "--replay-latency needs --replay";
+            return false;
+        }
+        if (unsorted && !ChapterSink::canStream(format)) {
+            error = "--unsorted needs --format jsonl, tsv or urls";
+            return false;
         }
+        if (!metricsJson.empty() || !metricsProm.empty()) {
+            metrics = std::make_shared<Metrics>();
+        }
+        return true;
     }
-};
-
-// ============================================================================
-// HTTP CLIENT
-// ============================================================================
-
-struct HTTPResponse {
-    std::string data;
-    long status_code = 0;
-    bool success = false;
-    std::string error_message;
-};
-
-class HTTPClient {
-private:
-    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, HTTPResponse* response) {
-        size_t totalSize = size * nmemb;
-        response->data.append(static_cast<char*>(contents), totalSize);
-        return totalSize;
+    
+    // Colors, the banner and the live progress line are for terminals only
+    void configureLogging() {
+        const char* noColorEnv = std::getenv("NO_COLOR");
+        log.color = !noColor && log.format == Logger::Format::Text && isatty(toStdout ? 2 : 1) &&
+                    !(noColorEnv && *noColorEnv);
+        Logger::configure(log);
     }
     
-public:
-    static HTTPResponse get(const std::string& url, int timeout = 30) {
-        HTTPResponse response;
-        CURL* curl = curl_easy_init();
-        
-        if (!curl) {
-            response.error_message = "Failed to initialize CURL";
-            return response;
+    // Throws std::invalid_argument if a selector does not compile
+    ScrapeOptions scrapeOptions() const {
+        ScrapeOptions options;
+        options.outputDir = outputDir;
+        options.streaming = streaming;
+        options.incremental = incremental;
+        options.knownStreakToStop = stopAfterKnown;
+        options.crawlPages = crawlPages;
+        options.crawlJobs = crawlJobs;
+        options.metrics = metrics;
+        options.format = format;
+        options.toStdout = toStdout;
+        options.unsorted = unsorted;
+        if (!imageSelector.empty()) {
+            options.imageSelector = std::make_shared<const CSSSelector>(imageSelector);
         }
         
-        // Configure CURL
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, "linkex/2.0 (Advanced Web Scraper)");
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-        
-        // Perform request
-        CURLcode res = curl_easy_perform(curl);
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response.status_code);
-        
-        if (res == CURLE_OK && response.status_code == 200) {
-            response.success = true;
-        } else {
-            response.error_message = curl_easy_strerror(res);
-            if (response.status_code != 200) {
-                response.error_message += " (HTTP " + std::to_string(response.status_code) + ")";
+        if (!chapterSelectors.empty() || !titleSelector.empty()) {
+            const PageSelectors& defaults = *PageSelectors::defaults();
+            std::vector<std::string> chapters;
+            for (const auto& selector : defaults.chapterLinks) {
+                chapters.push_back(selector.text());
             }
+            options.selectors = PageSelectors::compile(
+                chapterSelectors.empty() ? chapters : chapterSelectors,
+                titleSelector.empty() ? defaults.title.text() : titleSelector);
         }
-        
-        curl_easy_cleanup(curl);
-        return response;
+        return options;
+    }
+    
+    HTTPClientOptions clientOptions() const {
+        HTTPClientOptions options;
+        options.cacheDir = cacheDir;
+        options.rateLimit.requestsPerSecond = rate;
+        options.rateLimit.burst = std::max(1.0, rate);
+        options.rateLimit.maxConcurrency = maxConcurrency;
+        options.retry.maxRetries = retries;
+        options.retry.hedge = hedge;
+        options.metrics = metrics;
+        options.recordPath = recordPath;
+        options.replayPath = replayPath;
+        options.replayLatency = replayLatency;
+        return options;
     }
 };
 
-// ============================================================================
-// HTML PARSER
-// ============================================================================
+// Initialize curl once for the whole process, whichever mode runs
+struct CurlGlobal {
+    CurlGlobal() { curl_global_init(CURL_GLOBAL_DEFAULT); }
+    ~CurlGlobal() { curl_global_cleanup(); }
+};
 
-class HTMLElement {
-private:
-    GumboNode* node_;
-    
-public:
-    HTMLElement(GumboNode* node) : node_(node) {}
-    
-    std::string getAttribute(const std::string& name) const {
-        if (node_->type != GUMBO_NODE_ELEMENT) return "";
-        
-        GumboAttribute* attr = gumbo_get_attribute(&node_->v.element.attributes, name.c_str());
-        return attr ? std::string(attr->value) : "";
-    }
-    
-    std::string getText() const {
-        return getTextContent(node_);
-    }
-    
-private:
-    std::string getTextContent(GumboNode* node) const {
-        if (node->type == GUMBO_NODE_TEXT) {
-            return std::string(node->v.text.text);
-        } else if (node->type == GUMBO_NODE_ELEMENT) {
-            std::string text;
-            GumboVector* children = &node->v.element.children;
-            for (unsigned int i = 0; i < children->length; ++i) {
-                text += getTextContent(static_cast<GumboNode*>(children->data[i]));
-            }
-            return text;
-        }
-        return "";
+// Hands std::cout its own buffer back when main returns, so its final flush at
+// exit never goes through a buffer main pointed it at
+struct CoutRestore {
+    std::streambuf* original = std::cout.rdbuf();
+    ~CoutRestore() {
+        Logger::flush();
+        std::cout.flush();
+        std::cout.rdbuf(original);
     }
 };
 
-class HTMLParser {
-private:
-    std::unique_ptr<GumboOutput, void(*)(GumboOutput*)> output_;
-    
-public:
-    HTMLParser(const std::string& html) 
-        : output_(gumbo_parse(html.c_str()), 
-                 [](GumboOutput* output) { gumbo_destroy_output(&kGumboDefaultOptions, output); }) {
-        if (!output_) {
-            throw std::runtime_error("Failed to parse HTML");
-        }
+bool prepareOutputDir(const std::string& dir) {
+    if (dir.empty()) return true;
+    
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        Logger::error("Could not create output directory " + dir + ": " + ec.message());
+        return false;
     }
+    return true;
+}
+
+int runSingle(const CommandLine& cli) {
+    ScrapeOptions options = cli.scrapeOptions();
     
-    std::vector<HTMLElement> select(const std::string& selector) {
-        std::vector<GumboNode*> nodes;
-        findElementsBySelector(output_->root, selector, nodes);
-        
-        std::vector<HTMLElement> elements;
-        elements.reserve(nodes.size());
-        for (auto* node : nodes) {
-            elements.emplace_back(node);
-        }
-        return elements;
-    }
+    HTTPClient client(cli.clientOptions());
+    MangaScraper scraper(cli.url, client, options);
     
-private:
-    void findElementsBySelector(GumboNode* node, const std::string& selector, std::vector<GumboNode*>& results) {
-        if (node->type != GUMBO_NODE_ELEMENT) return;
-        
-        // Enhanced selector matching
-        if (selector == "#chapters-list li > a" || selector == "#chapters-list a") {
-            findChapterLinks(node, results);
-        } else if (selector == "#manga-info-rightColumn h1" || 
-                   selector == "#manga-info-rightColumn > div:nth-child(1) > h1") {
-            findMangaTitle(node, results);
-        }
-        
-        // Recursively search children
-        if (node->type == GUMBO_NODE_ELEMENT) {
-            GumboVector* children = &node->v.element.children;
-            for (unsigned int i = 0; i < children->length; ++i) {
-                findElementsBySelector(static_cast<GumboNode*>(children->data[i]), selector, results);
-            }
-        }
+    if (!scraper.scrape()) {
+        Logger::error("Scraping operation failed");
+        return 1;
     }
     
-    void findChapterLinks(GumboNode* node, std::vector<GumboNode*>& results) {
-        if (node->v.element.tag == GUMBO_TAG_DIV || node->v.element.tag == GUMBO_TAG_UL) {
-            GumboAttribute* id_attr = gumbo_get_attribute(&node->v.element.attributes, "id");
-            if (id_attr && std::string(id_attr->value) == "chapters-list") {
-                collectAllLinks(node, results);
-            }
-        }
+    if (options.crawlPages && !scraper.crawlPages()) {
+        Logger::error("Chapter page crawl failed");
+        return 1;
     }
     
-    void findMangaTitle(GumboNode* node, std::vector<GumboNode*>& results) {
-        if (node->v.element.tag == GUMBO_TAG_DIV) {
-            GumboAttribute* id_attr = gumbo_get_attribute(&node->v.element.attributes, "id");
-            if (id_attr && std::string(id_attr->value) == "manga-info-rightColumn") {
-                collectAllH1(node, results);
-            }
-        }
-    }
+    scraper.printSummary();
     
-    void collectAllLinks(GumboNode* node, std::vector<GumboNode*>& results) {
-        if (node->type == GUMBO_NODE_ELEMENT) {
-            if (node->v.element.tag == GUMBO_TAG_A) {
-                results.push_back(node);
-            }
-            
-            GumboVector* children = &node->v.element.children;
-            for (unsigned int i = 0; i < children->length; ++i) {
-                collectAllLinks(static_cast<GumboNode*>(children->data[i]), results);
-            }
-        }
+    if (!scraper.saveToFile()) {
+        Logger::error("Failed to save results to file");
+        return 1;
     }
     
-    void collectAllH1(GumboNode* node, std::vector<GumboNode*>& results) {
-        if (node->type == GUMBO_NODE_ELEMENT) {
-            if (node->v.element.tag == GUMBO_TAG_H1) {
-                results.push_back(node);
-                return; // Take first H1 found
-            }
-            
-            GumboVector* children = &node->v.element.children;
-            for (unsigned int i = 0; i < children->length; ++i) {
-                collectAllH1(static_cast<GumboNode*>(children->data[i]), results);
-                if (!results.empty()) return; // Stop after first H1
-            }
-        }
-    }
-};
-
-// ============================================================================
-// URL UTILITIES
-// ============================================================================
+    Logger::success("Operation completed successfully!");
+    return 0;
+}
 
-class URLUtils {
-public:
-    static std::string join(const std::string& baseUrl, const std::string& relativeUrl) {
-        if (relativeUrl.empty()) return baseUrl;
-        
-        // If relative URL is already absolute, return it
-        if (relativeUrl.find("http://") == 0 || relativeUrl.find("https://") == 0) {
-            return relativeUrl;
-        }
-        
-        std::string result = baseUrl;
-        
-        // Remove trailing slash from base URL
-        if (!result.empty() && result.back() == '/') {
-            result.pop_back();
-        }
-        
-        // Add leading slash to relative URL if needed
-        std::string relative = relativeUrl;
-        if (!relative.empty() && relative.front() != '/') {
-            relative = "/" + relative;
+// A URL list from a file or stdin ("-"); false, having logged why, if there is none
+bool readUrls(const std::string& path, const std::string& what, std::vector<std::string>& urls) {
+    if (path == "-") {
+        urls = BatchRunner::readUrlList(std::cin);
+    } else {
+        std::ifstream input(path);
+        if (!input.is_open()) {
+            Logger::error("Could not open " + what + " file: " + path);
+            return false;
         }
-        
-        return result + relative;
+        urls = BatchRunner::readUrlList(input);
     }
     
-    static bool isValid(const std::string& url) {
-        return url.find("http://") == 0 || url.find("https://") == 0;
+    if (urls.empty()) {
+        Logger::error("No URLs found in " + what + " input");
+        return false;
     }
-};
-
-// ============================================================================
-// STRING UTILITIES
-// ============================================================================
+    return true;
+}
 
-class StringUtils {
-public:
-    static std::string trim(const std::string& str) {
-        size_t start = str.find_first_not_of(" \t\n\r");
-        if (start == std::string::npos) return "";
-        size_t end = str.find_last_not_of(" \t\n\r");
-        return str.substr(start, end - start + 1);
+int runBatch(const CommandLine& cli) {
+    std::vector<std::string> urls;
+    if (!readUrls(cli.batchFile, "batch", urls)) {
+        return 1;
     }
     
-    static std::string toLower(const std::string& str) {
-        std::string result = str;
-        std::transform(result.begin(), result.end(), result.begin(), ::tolower);
-        return result;
-    }
+    ScrapeOptions options = cli.scrapeOptions();
     
-    static std::string createSafeFilename(const std::string& title) {
-        std::string filename = toLower(trim(title));
-        
-        // Replace spaces and special characters
-        std::regex specialChars(R"([^\w\-_\.])", std::regex_constants::icase);
-        filename = std::regex_replace(filename, specialChars, "_");
-        
-        // Replace multiple underscores with single
-        std::regex multipleUnderscores("_{2,}");
-        filename = std::regex_replace(filename, multipleUnderscores, "_");
-        
-        // Remove leading/trailing underscores
-        if (!filename.empty() && filename.front() == '_') filename.erase(0, 1);
-        if (!filename.empty() && filename.back() == '_') filename.pop_back();
-        
-        return filename.empty() ? "chapters" : filename;
-    }
+    BatchRunner runner(std::move(urls), cli.jobs, options, cli.clientOptions());
+    runner.run();
+    runner.printSummary();
     
-    static std::vector<std::string> naturalSortTokens(const std::string& str) {
-        std::vector<std::string> tokens;
-        std::regex tokenRegex(R"((\d+|\D+))");
-        auto begin = std::sregex_iterator(str.begin(), str.end(), tokenRegex);
-        auto end = std::sregex_iterator();
-        
-        for (auto i = begin; i != end; ++i) {
-            tokens.push_back(i->str());
-        }
-        return tokens;
+    std::string summaryFile = cli.outputDir.empty()
+        ? "batch_summary.txt"
+        : (std::filesystem::path(cli.outputDir) / "batch_summary.txt").string();
+    if (!runner.writeSummary(summaryFile)) {
+        return 1;
     }
     
-    static bool naturalSort(const std::string& a, const std::string& b) {
-        auto aTokens = naturalSortTokens(a);
-        auto bTokens = naturalSortTokens(b);
-        
-        size_t minSize = std::min(aTokens.size(), bTokens.size());
-        
-        for (size_t i = 0; i < minSize; ++i) {
-            const std::string& aToken = aTokens[i];
-            const std::string& bToken = bTokens[i];
-            
-            bool aIsNumber = std::all_of(aToken.begin(), aToken.end(), ::isdigit);
-            bool bIsNumber = std::all_of(bToken.begin(), bToken.end(), ::isdigit);
-            
-            if (aIsNumber && bIsNumber) {
-                int aNum = std::stoi(aToken);
-                int bNum = std::stoi(bToken);
-                if (aNum != bNum) {
-                    return aNum < bNum;
-                }
-            } else {
-                std::string aLower = toLower(aToken);
-                std::string bLower = toLower(bToken);
-                if (aLower != bLower) {
-                    return aLower < bLower;
-                }
-            }
-        }
-        
-        return aTokens.size() < bTokens.size();
+    if (runner.failureCount() > 0) {
+        Logger::warning(std::to_string(runner.failureCount()) + " series failed, see " + summaryFile);
+        return 1;
     }
-};
+    
+    Logger::success("Operation completed successfully!");
+    return 0;
+}
 
-// ============================================================================
-// MAIN SCRAPER CLASS
-// ============================================================================
+std::atomic<bool> stopRequested{false};
 
-class MangaScraper {
-private:
-    std::string baseUrl_;
-    std::vector<std::string> chapterLinks_;
-    std::string mangaTitle_;
-    
-public:
-    explicit MangaScraper(const std::string& url) : baseUrl_(url) {
-        if (!URLUtils::isValid(url)) {
-            throw std::invalid_argument("Invalid URL provided");
-        }
+void requestStop(int) {
+    stopRequested = true;
+}
+
+int runServe(const CommandLine& cli) {
+    JobServer server(cli.serve, cli.jobs, cli.scrapeOptions(), cli.clientOptions());
+    if (!server.listen()) {
+        return 1;
     }
     
-    bool scrape() {
-        try {
-            Logger::info("Starting scrape for: " + baseUrl_);
-            
-            // Fetch webpage
-            Logger::info("Fetching webpage...");
-            HTTPResponse response = HTTPClient::get(baseUrl_);
-            
-            if (!response.success) {
-                Logger::error("Failed to fetch webpage: " + response.error_message);
-                return false;
-            }
-            
-            Logger::success("Webpage fetched successfully (" + std::to_string(response.data.length()) + " bytes)");
-            
-            // Parse HTML
-            Logger::info("Parsing HTML content...");
-            HTMLParser parser(response.data);
-            
-            // Extract chapter links
-            Logger::info("Extracting chapter links...");
-            auto chapterElements = parser.select("#chapters-list li > a");
-            
-            if (chapterElements.empty()) {
-                // Try alternative selector
-                chapterElements = parser.select("#chapters-list a");
-            }
-            
-            if (chapterElements.empty()) {
-                Logger::warning("No chapter links found with standard selectors");
-                return false;
-            }
-            
-            // Process chapter links with progress bar
-            ProgressBar progress(chapterElements.size(), "Processing chapters");
-            
-            for (size_t i = 0; i < chapterElements.size(); ++i) {
-                const auto& element = chapterElements[i];
-                
-                std::string href = element.getAttribute("href");
-                if (href.empty()) {
-                    href = element.getAttribute("src");
-                }
-                
-                if (!href.empty()) {
-                    std::string fullUrl = URLUtils::join("https://demonicscans.org", href);
-                    chapterLinks_.push_back(fullUrl);
-                }
-                
-                progress.update(i + 1);
-                std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Small delay for visual effect
-            }
-            
-            // Sort chapters naturally
-            Logger::info("Sorting chapters naturally...");
-            std::sort(chapterLinks_.begin(), chapterLinks_.end(), StringUtils::naturalSort);
-            
-            // Extract manga title
-            Logger::info("Extracting manga title...");
-            auto titleElements = parser.select("#manga-info-rightColumn h1");
-            
-            if (!titleElements.empty()) {
-                mangaTitle_ = StringUtils::trim(titleElements[0].getText());
-            }
-            
-            if (mangaTitle_.empty()) {
-                Logger::warning("Could not extract manga title, using default");
-                mangaTitle_ = "unknown_manga";
-            } else {
-                Logger::success("Found manga: " + mangaTitle_);
-            }
-            
-            return true;
-            
-        } catch (const std::exception& e) {
-            Logger::error("Scraping failed: " + std::string(e.what()));
-            return false;
-        }
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN); // Clients that hang up early fail their own send()
+    server.run(stopRequested);
+    return 0;
+}
+
+// New chapters are appended to <output-dir>/watch_events.<ext> (or written to
+// stdout) until SIGINT or SIGTERM
+int runWatch(const CommandLine& cli) {
+    std::vector<std::string> urls;
+    if (!readUrls(cli.watchFile, "watch", urls)) {
+        return 1;
     }
     
-    bool saveToFile() {
-        if (chapterLinks_.empty()) {
-            Logger::error("No chapter links to save");
-            return false;
-        }
-        
-        std::string filename = StringUtils::createSafeFilename(mangaTitle_) + ".txt";
-        
-        Logger::info("Saving to file: " + filename);
-        
-        std::ofstream file(filename);
-        if (!file.is_open()) {
-            Logger::error("Could not create file: " + filename);
-            return false;
-        }
-        
-        // Write header with metadata
-        file << "# Manga Chapter Links\n";
-        file << "# Title: " << mangaTitle_ << "\n";
-        file << "# Source: " << baseUrl_ << "\n";
-        file << "# Total Chapters: " << chapterLinks_.size() << "\n";
-        file << "# Generated: " << getCurrentTimestamp() << "\n";
-        file << "# ==========================================\n\n";
-        
-        // Write chapter links
-        for (size_t i = 0; i < chapterLinks_.size(); ++i) {
-            file << "# Chapter " << (i + 1) << "\n";
-            file << chapterLinks_[i] << "\n\n";
-        }
-        
-        file.close();
-        
-        Logger::success("Successfully saved " + std::to_string(chapterLinks_.size()) + 
-                       " chapter links to " + filename);
-        return true;
+    auto inOutputDir = [&](const std::string& filename) {
+        return cli.outputDir.empty() ? filename : (std::filesystem::path(cli.outputDir) / filename).string();
+    };
+    std::string eventsPath = cli.toStdout ? "-" : inOutputDir(std::string("watch_events") + ChapterSink::extension(cli.format));
+    auto events = std::make_shared<OutputFile>();
+    if (!events->open(eventsPath, true)) {
+        Logger::error("Could not open " + eventsPath + ": " + events->error());
+        return 1;
     }
-    
-    void printSummary() const {
-        std::cout << "\n" << std::string(60, '=') << std::endl;
-        std::cout << "\033[1;36m SCRAPING SUMMARY \033[0m" << std::endl;
-        std::cout << std::string(60, '=') << std::endl;
-        std::cout << "\033[1mManga Title:\033[0m " << mangaTitle_ << std::endl;
-        std::cout << "\033[1mSource URL:\033[0m " << baseUrl_ << std::endl;
-        std::cout << "\033[1mChapters Found:\033[0m " << chapterLinks_.size() << std::endl;
-        std::cout << "\033[1mFilename:\033[0m " << StringUtils::createSafeFilename(mangaTitle_) << ".txt" << std::endl;
-        std::cout << std::string(60, '=') << std::endl;
+    if (!cli.toStdout) {
+        Logger::info("Appending new chapters to " + eventsPath);
     }
     
-private:
-    std::string getCurrentTimestamp() const {
-        auto now = std::chrono::system_clock::now();
-        auto time_t = std::chrono::system_clock::to_time_t(now);
-        
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-        return ss.str();
+    WatchOptions watch;
+    watch.minInterval = cli.minInterval;
+    watch.maxInterval = cli.maxInterval;
+    watch.workers = cli.jobs;
+    watch.statePath = inOutputDir("watch_state.tsv");
+    
+    WatchScheduler scheduler(urls, watch, cli.scrapeOptions(), cli.clientOptions(), events);
+    if (scheduler.size() == 0) {
+        Logger::error("No valid URLs to watch");
+        return 1;
     }
-};
-
-// ============================================================================
-// MAIN FUNCTION
-// ============================================================================
-
-void printBanner() {
-    std::cout << "\033[1;36m" << std::endl;
-    std::cout << "██╗     ██╗███╗   ██╗██╗  ██╗███████╗██╗  ██╗" << std::endl;
-    std::cout << "██║     ██║████╗  ██║██║ ██╔╝██╔════╝╚██╗██╔╝" << std::endl;
-    std::cout << "██║     ██║██╔██╗ ██║█████╔╝ █████╗   ╚███╔╝ " << std::endl;
-    std::cout << "██║     ██║██║╚██╗██║██╔═██╗ ██╔══╝   ██╔██╗ " << std::endl;
-    std::cout << "███████╗██║██║ ╚████║██║  ██╗███████╗██╔╝ ██╗" << std::endl;
-    std::cout << "╚══════╝╚═╝╚═╝  ╚═══╝╚═╝  ╚═╝╚══════╝╚═╝  ╚═╝" << std::endl;
-    std::cout << "\033[0m" << std::endl;
-    std::cout << "\033[1;33mAdvanced Manga Chapter Link Extractor v2.0\033[0m" << std::endl;
-    std::cout << "\033[90mBuilt with C++17 | Powered by libcurl & gumbo-parser\033[0m" << std::endl;
-    std::cout << std::string(60, '-') << std::endl << std::endl;
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    scheduler.run(stopRequested);
+    return 0;
 }
 
-void printUsage() {
-    std::cout << "\033[1mUsage:\033[0m linkex <URL>" << std::endl;
-    std::cout << "\033[1mExample:\033[0m linkex https://demonicscans.org/manga/The-Beginning-After-the-End" << std::endl;
-    std::cout << std::endl;
-    std::cout << "\033[1mFeatures:\033[0m" << std::endl;
-    std::cout << "  • Natural chapter sorting (1, 2, 10 instead of 1, 10, 2)" << std::endl;
-    std::cout << "  • Intelligent URL handling (relative & absolute)" << std::endl;
-    std::cout << "  • Comprehensive error handling & logging" << std::endl;
-    std::cout << "  • Progress tracking with visual indicators" << std::endl;
-    std::cout << "  • Safe filename generation" << std::endl;
-    std::cout << "  • Metadata-rich output files" << std::endl;
+// Written whether or not the run succeeded, so failures show up on dashboards too
+bool writeMetrics(const CommandLine& cli) {
+    bool written = true;
+    if (!cli.metricsJson.empty()) {
+        if (cli.metrics->writeJson(cli.metricsJson)) {
+            Logger::info("Metrics written to " + cli.metricsJson);
+        } else {
+            Logger::error("Could not write metrics to " + cli.metricsJson);
+            written = false;
+        }
+    }
+    if (!cli.metricsProm.empty()) {
+        if (cli.metrics->writePrometheus(cli.metricsProm)) {
+            Logger::info("Prometheus metrics written to " + cli.metricsProm);
+        } else {
+            Logger::error("Could not write Prometheus metrics to " + cli.metricsProm);
+            written = false;
+        }
+    }
+    return written;
 }
 
 int main(int argc, char* argv[]) {
-    printBanner();
+    CommandLine cli;
+    std::string error;
+    bool parsed = cli.parse(argc, argv, error);
+    CoutRestore restoreCout;
+    
+    // Chapters own stdout; everything meant for people moves to stderr
+    if (cli.toStdout) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
     
-    if (argc != 2) {
+    // Declared before the logger's writer thread starts, so it outlives it
+    static AnsiStripBuffer plain(std::cout.rdbuf());
+    cli.configureLogging();
+    if (!Logger::colorEnabled()) {
+        std::cout.rdbuf(&plain);
+    } else {
+        printBanner();
+    }
+    if (!parsed) {
+        if (argc > 1) Logger::error(error);
+        Logger::flush();
         printUsage();
         return 1;
     }
     
-    // Initialize curl globally
-    curl_global_init(CURL_GLOBAL_DEFAULT);
+    if (!prepareOutputDir(cli.outputDir)) {
+        return 1;
+    }
     
+    CurlGlobal curl;
+    
+    int status = 0;
     try {
-        MangaScraper scraper(argv[1]);
-        
-        if (scraper.scrape()) {
-            scraper.printSummary();
-            
-            if (scraper.saveToFile()) {
-                Logger::success("Operation completed successfully!");
-            } else {
-                Logger::error("Failed to save results to file");
-                curl_global_cleanup();
-                return 1;
-            }
+        if (!cli.serve.empty()) {
+            status = runServe(cli);
+        } else if (!cli.watchFile.empty()) {
+            status = runWatch(cli);
         } else {
-            Logger::error("Scraping operation failed");
-            curl_global_cleanup();
-            return 1;
+            status = cli.batchFile.empty() ? runSingle(cli) : runBatch(cli);
         }
-        
     } catch (const std::exception& e) {
         Logger::error("Fatal error: " + std::string(e.what()));
-        curl_global_cleanup();
-        return 1;
+        status = 1;
     }
     
-    // Cleanup curl
-    curl_global_cleanup();
+    if (cli.metrics && !writeMetrics(cli)) {
+        status = 1;
+    }
+    
+    if (status != 0) {
+        return status;
+    }
     
+    Logger::flush();
     std::cout << "\n\033[1;32mThank you for using linkex! 🚀\033[0m" << std::endl;
     return 0;
-}
\ No newline at end of file
+}
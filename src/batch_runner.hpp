@@ -0,0 +1,358 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "bounded_queue.hpp"
+#include "http_client.hpp"
+#include "logger.hpp"
+#include "manga_scraper.hpp"
+#include "string_utils.hpp"
+
+// ============================================================================
+// BATCH RUNNER
+// ============================================================================
+
+struct BatchResult {
+    std::string url;
+    std::string title;
+    std::string filename;
+    size_t chapters = 0;
+    size_t added = 0;   // Incremental runs only
+    size_t removed = 0;
+    bool success = false;
+    std::string error;
+    double seconds = 0.0;
+};
+
+// Runs each series through three stages connected by bounded queues: fetch
+// (network, --jobs transfers on the HTTP client's event loop, or --jobs
+// threads when streaming), extract (parse, resolve, sort; one thread per core)
+// and save (one thread, or --jobs when chapter pages are crawled, since that is
+// network-bound too). One series is parsed while the next downloads and the
+// previous one is written.
+class BatchRunner {
+private:
+    struct Job {
+        size_t index = 0;
+        std::unique_ptr<MangaScraper> scraper;
+        std::chrono::steady_clock::time_point start;
+        bool ok = false;
+        std::string error; // Set when the scraper could not be created
+    };
+    
+    struct StageThreads {
+        size_t fetch = 0;
+        size_t extract = 0;
+        size_t save = 0;
+        size_t transfers = 0;    // Fetches in flight at once
+        size_t fetchWaits = 0;   // Fetched pages that waited for an extract thread
+        size_t extractWaits = 0; // Extracted series that waited for a save thread
+    };
+    
+    std::vector<std::string> urls_;
+    size_t concurrency_;
+    ScrapeOptions options_;
+    std::vector<BatchResult> results_;
+    double elapsedSeconds_ = 0.0;
+    StageThreads stages_;
+    HTTPClient client_; // Shared by all jobs so connections stay warm across series
+
+public:
+    BatchRunner(std::vector<std::string> urls, size_t concurrency, const ScrapeOptions& options,
+                const HTTPClientOptions& clientOptions = HTTPClientOptions())
+        : urls_(std::move(urls)), concurrency_(std::max<size_t>(1, concurrency)), options_(options),
+          client_(clientOptions) {
+        options_.showProgress = false; // Progress bars from parallel jobs would garble the terminal
+    }
+    
+    // One URL per line; blank lines, '#' comments and duplicates are skipped
+    static std::vector<std::string> readUrlList(std::istream& in) {
+        std::vector<std::string> urls;
+        std::unordered_set<std::string> seen; // Watch lists run to tens of thousands of lines
+        std::string line;
+        while (std::getline(in, line)) {
+            line = StringUtils::trim(line);
+            if (line.empty() || line.front() == '#') continue;
+            if (seen.insert(line).second) {
+                urls.push_back(line);
+            }
+        }
+        return urls;
+    }
+    
+    void run() {
+        results_.assign(urls_.size(), BatchResult());
+        stages_.transfers = std::min(concurrency_, urls_.size());
+        stages_.fetch = options_.streaming ? stages_.transfers : std::min<size_t>(1, urls_.size());
+        stages_.extract = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), urls_.size());
+        stages_.save = options_.crawlPages ? stages_.transfers : 1;
+        
+        Logger::info("Starting batch of " + std::to_string(urls_.size()) + " series with " +
+                     std::to_string(stages_.transfers) + " concurrent jobs (" + std::to_string(stages_.extract) +
+                     " extract, " + std::to_string(stages_.save) + " save threads)");
+        
+        auto start = std::chrono::steady_clock::now();
+        BoundedQueue<Job> fetched(stages_.extract * 2);
+        BoundedQueue<Job> extracted(stages_.save * 2);
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> completed{0};
+        std::vector<std::thread> threads;
+        
+        startStage(threads, stages_.fetch, &fetched, [&] {
+            if (!options_.streaming) {
+                fetchAll(fetched);
+                return;
+            }
+            for (size_t i = next++; i < urls_.size(); i = next++) {
+                Job job = startJob(i);
+                fetched.push(std::move(job));
+            }
+        });
+        startStage(threads, stages_.extract, &extracted, [&] {
+            Job job;
+            while (fetched.pop(job)) {
+                if (job.ok) {
+                    Logger::setContext(contextFor(job));
+                    job.ok = job.scraper->extract() && job.scraper->finish();
+                    Logger::setContext("");
+                }
+                extracted.push(std::move(job));
+            }
+        });
+        startStage(threads, stages_.save, nullptr, [&] {
+            Job job;
+            while (extracted.pop(job)) {
+                results_[job.index] = finishJob(job);
+                report(results_[job.index], ++completed);
+                job = Job(); // Release the scraper before waiting for the next series
+            }
+        });
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        
+        stages_.fetchWaits = fetched.fullWaits();
+        stages_.extractWaits = extracted.fullWaits();
+        elapsedSeconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    size_t failureCount() const {
+        return std::count_if(results_.begin(), results_.end(), [](const BatchResult& r) { return !r.success; });
+    }
+    
+    bool writeSummary(const std::string& filename) const {
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            Logger::error("Could not create file: " + filename);
+            return false;
+        }
+        
+        // Write header with metadata, then one tab-separated row per series
+        file << "# Linkex Batch Summary\n";
+        file << "# Series: " << results_.size() << "\n";
+        file << "# Succeeded: " << (results_.size() - failureCount()) << "\n";
+        file << "# Failed: " << failureCount() << "\n";
+        file << "# Total Chapters: " << totalChapters() << "\n";
+        file << "# Concurrency: " << concurrency_ << "\n";
+        file << "# Pipeline: " << stages_.fetch << " fetch (" << stages_.transfers << " in flight), " << stages_.extract << " extract, " << stages_.save
+             << " save threads; " << stages_.fetchWaits << " fetch waits, " << stages_.extractWaits << " extract waits\n";
+        file << "# Elapsed: " << std::fixed << std::setprecision(2) << elapsedSeconds_ << "s\n";
+        HTTPClient::Stats http = client_.stats();
+        file << "# HTTP Requests: " << http.requests << " (" << http.http2Transfers << " over HTTP/2)\n";
+        file << "# Handle Pool: " << http.poolHits << " hits, " << http.poolMisses << " misses\n";
+        file << "# Connections: " << http.connectionsReused << " reused, " << http.connectionsOpened << " opened\n";
+        file << "# Transfer: " << http.wireBytes << " bytes on the wire, " << http.decodedBytes << " decoded, "
+             << http.buffersReused << " receive buffers reused\n";
+        if (const ResponseCache* cache = client_.cache()) {
+            ResponseCache::Stats c = cache->stats();
+            file << "# Response Cache: " << c.hits << " hits (304), " << c.refreshed << " refreshed, "
+                 << c.misses << " misses, " << c.stores << " stored\n";
+        }
+        RateLimiter::Stats limits = client_.limiter().stats();
+        file << "# Rate Limiter: " << limits.backoffs << " back-offs, " << limits.waitedSeconds << "s waiting\n";
+        file << "# Generated: " << MangaScraper::getCurrentTimestamp() << "\n";
+        file << "# ==========================================\n\n";
+        file << "status\tchapters\tadded\tremoved\tseconds\turl\ttitle\tfile\terror\n";
+        
+        for (const auto& result : results_) {
+            file << (result.success ? "ok" : "failed") << "\t"
+                 << result.chapters << "\t"
+                 << (options_.incremental ? std::to_string(result.added) : "-") << "\t"
+                 << (options_.incremental ? std::to_string(result.removed) : "-") << "\t"
+                 << result.seconds << "\t"
+                 << result.url << "\t"
+                 << result.title << "\t"
+                 << result.filename << "\t"
+                 << result.error << "\n";
+        }
+        
+        Logger::success("Batch summary written to " + filename);
+        return true;
+    }
+    
+    void printSummary() const {
+        Logger::flush();
+        std::cout << "\n" << std::string(60, '=') << std::endl;
+        std::cout << "\033[1;36m BATCH SUMMARY \033[0m" << std::endl;
+        std::cout << std::string(60, '=') << std::endl;
+        std::cout << "\033[1mSeries:\033[0m " << results_.size() << std::endl;
+        std::cout << "\033[1mSucceeded:\033[0m " << (results_.size() - failureCount()) << std::endl;
+        std::cout << "\033[1mFailed:\033[0m " << failureCount() << std::endl;
+        std::cout << "\033[1mChapters Found:\033[0m " << totalChapters() << std::endl;
+        std::cout << "\033[1mElapsed:\033[0m " << std::fixed << std::setprecision(2) << elapsedSeconds_ << "s" << std::endl;
+        std::cout << "\033[1mPipeline:\033[0m " << stages_.fetch << " fetch (" << stages_.transfers << " in flight), " << stages_.extract << " extract, "
+                  << stages_.save << " save threads (fetch waited " << stages_.fetchWaits << "x, extract waited "
+                  << stages_.extractWaits << "x)" << std::endl;
+        client_.printStats();
+        std::cout << std::string(60, '=') << std::endl;
+    }
+
+private:
+    // Each stage thread closes `output` as the last one of its stage finishes
+    template <typename Body>
+    static void startStage(std::vector<std::thread>& threads, size_t count, BoundedQueue<Job>* output, Body body) {
+        auto remaining = std::make_shared<std::atomic<size_t>>(count);
+        for (size_t i = 0; i < count; ++i) {
+            threads.emplace_back([body, output, remaining]() {
+                body();
+                if (--*remaining == 0 && output) output->close();
+            });
+        }
+    }
+    
+    std::string contextFor(const Job& job) const {
+        const std::string& url = urls_[job.index];
+        return url.substr(url.find_last_of('/') + 1);
+    }
+    
+    // Fetch stage on the client's event loop: this thread starts up to --jobs
+    // downloads and hands each finished one to the extract stage
+    void fetchAll(BoundedQueue<Job>& fetched) {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Job> done;
+        size_t inFlight = 0;
+        size_t next = 0;
+        
+        auto finished = [&](Job job) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.push_back(std::move(job));
+            --inFlight;
+            changed.notify_one();
+        };
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        while (next < urls_.size() || inFlight > 0 || !done.empty()) {
+            changed.wait(lock, [&] { return !done.empty() || (inFlight < concurrency_ && next < urls_.size()); });
+            while (!done.empty()) {
+                Job job = std::move(done.front());
+                done.pop_front();
+                lock.unlock();
+                fetched.push(std::move(job)); // Waits while the extract stage is behind
+                lock.lock();
+            }
+            while (inFlight < concurrency_ && next < urls_.size()) {
+                size_t index = next++;
+                ++inFlight;
+                lock.unlock();
+                startJobAsync(index, finished);
+                lock.lock();
+            }
+        }
+    }
+    
+    template <typename Finished>
+    void startJobAsync(size_t index, Finished& finished) {
+        auto job = std::make_shared<Job>();
+        job->index = index;
+        job->start = std::chrono::steady_clock::now();
+        Logger::setContext(contextFor(*job));
+        try {
+            job->scraper = std::make_unique<MangaScraper>(urls_[index], client_, options_);
+            job->scraper->fetchAsync([job, &finished](bool ok) {
+                job->ok = ok;
+                finished(std::move(*job));
+            });
+        } catch (const std::exception& e) {
+            job->error = e.what();
+            finished(std::move(*job));
+        }
+        Logger::setContext("");
+    }
+    
+    // Fetch stage, one thread per streamed series
+    Job startJob(size_t index) {
+        Job job;
+        job.index = index;
+        job.start = std::chrono::steady_clock::now();
+        Logger::setContext(contextFor(job));
+        try {
+            job.scraper = std::make_unique<MangaScraper>(urls_[index], client_, options_);
+            job.ok = job.scraper->fetch();
+        } catch (const std::exception& e) {
+            job.error = e.what();
+        }
+        Logger::setContext("");
+        return job;
+    }
+    
+    // Save stage
+    BatchResult finishJob(Job& job) {
+        BatchResult result;
+        result.url = urls_[job.index];
+        result.error = job.error;
+        Logger::setContext(contextFor(job));
+        
+        try {
+            MangaScraper* scraper = job.scraper.get();
+            if (job.ok && scraper->saveToFile() && (!options_.crawlPages || scraper->crawlPages())) {
+                result.success = true;
+                result.title = scraper->title();
+                result.filename = scraper->outputPath();
+                result.chapters = scraper->chapterLinks().size();
+                result.added = scraper->delta().added.size();
+                result.removed = scraper->delta().removed.size();
+            } else if (scraper) {
+                result.error = scraper->lastError();
+            }
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.start).count();
+        
+        Logger::setContext("");
+        return result;
+    }
+    
+    void report(const BatchResult& result, size_t done) const {
+        std::string progress = "(" + std::to_string(done) + "/" + std::to_string(urls_.size()) + ") ";
+        if (result.success) {
+            std::string changes = options_.incremental
+                ? " (" + std::to_string(result.added) + " new, " + std::to_string(result.removed) + " removed)"
+                : "";
+            Logger::success(progress + result.title + ": " + std::to_string(result.chapters) + " chapters" + changes);
+        } else {
+            Logger::error(progress + result.url + ": " + result.error);
+        }
+    }
+    
+    size_t totalChapters() const {
+        size_t total = 0;
+        for (const auto& result : results_) total += result.chapters;
+        return total;
+    }
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// ============================================================================
+// BOUNDED QUEUE
+// ============================================================================
+
+// Hand-off between pipeline stages. push() blocks while the queue is full, so
+// a fast stage cannot run ahead and pile up pages in memory; pop() blocks
+// while it is empty. close() lets consumers drain what is left and stop.
+template <typename T>
+class BoundedQueue {
+private:
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_ = false;
+    size_t fullWaits_ = 0; // Pushes that found the queue full: the next stage is the bottleneck
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+    
+    // False if the queue was closed
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (items_.size() >= capacity_ && !closed_) {
+            ++fullWaits_;
+            notFull_.wait(lock, [this] { return items_.size() < capacity_ || closed_; });
+        }
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+    
+    // False once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+    
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+    
+    size_t fullWaits() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return fullWaits_;
+    }
+};
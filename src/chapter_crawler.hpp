@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "html_parser.hpp"
+#include "http_client.hpp"
+#include "logger.hpp"
+#include "string_utils.hpp"
+#include "url_utils.hpp"
+
+// ============================================================================
+// CHAPTER PAGE CRAWLER
+// ============================================================================
+
+struct ChapterPages {
+    std::string url;
+    std::vector<std::string> images; // Absolute image URLs in page order
+    bool success = false;
+    std::string error;
+};
+
+// Fetches chapter pages concurrently and extracts their image URLs. Each worker
+// owns a deque of chapter indices and takes from its front; a worker that runs
+// dry steals from the back of another's, so a few slow chapters never leave the
+// rest of the pool idle.
+class ChapterCrawler {
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+    
+    HTTPClient& client_;
+    size_t workers_;
+    std::shared_ptr<const CSSSelector> images_;
+    bool showProgress_;
+    std::atomic<size_t> steals_{0};
+
+public:
+    // Null imageSelector = every <img>
+    ChapterCrawler(HTTPClient& client, size_t workers,
+                   std::shared_ptr<const CSSSelector> imageSelector = nullptr, bool showProgress = true)
+        : client_(client), workers_(std::max<size_t>(1, workers)), images_(std::move(imageSelector)),
+          showProgress_(showProgress) {
+        if (!images_) {
+            images_ = std::make_shared<const CSSSelector>("img");
+        }
+    }
+    
+    // Results are in the same order as `chapters`
+    std::vector<ChapterPages> crawl(const std::vector<std::string>& chapters) {
+        std::vector<ChapterPages> results(chapters.size());
+        if (chapters.empty()) return results;
+        
+        // Contiguous blocks keep each worker on neighbouring chapters until it has to steal
+        size_t workerCount = std::min(workers_, chapters.size());
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        for (size_t w = 0; w < workerCount; ++w) {
+            queues.push_back(std::make_unique<WorkQueue>());
+            size_t begin = w * chapters.size() / workerCount;
+            size_t end = (w + 1) * chapters.size() / workerCount;
+            for (size_t i = begin; i < end; ++i) {
+                queues.back()->tasks.push_back(i);
+            }
+        }
+        
+        std::unique_ptr<ProgressBar> progress;
+        if (showProgress_) {
+            progress = std::make_unique<ProgressBar>(chapters.size(), "Crawling chapters");
+        }
+        std::atomic<size_t> completed{0};
+        std::string context = Logger::getContext();
+        
+        auto worker = [&](size_t self) {
+            Logger::setContext(context);
+            size_t index;
+            while (take(queues, self, index)) {
+                results[index] = fetchChapter(chapters[index]);
+                
+                size_t done = ++completed;
+                if (progress) progress->update(done);
+            }
+            Logger::setContext("");
+        };
+        
+        std::vector<std::thread> threads;
+        threads.reserve(workerCount);
+        for (size_t w = 0; w < workerCount; ++w) {
+            threads.emplace_back(worker, w);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return results;
+    }
+    
+    size_t steals() const { return steals_; }
+    
+    // Writes <dir>/<position>.txt per crawled chapter, where position is the
+    // chapter's 1-based number in the full chapter list
+    static bool writeManifest(const std::string& path, const ChapterPages& pages, size_t position,
+                              const std::string& timestamp) {
+        std::ofstream file(path);
+        if (!file.is_open()) return false;
+        
+        file << "# Chapter Page Images\n";
+        file << "# Chapter: " << position << "\n";
+        file << "# Source: " << pages.url << "\n";
+        file << "# Total Images: " << pages.images.size() << "\n";
+        file << "# Generated: " << timestamp << "\n";
+        file << "# ==========================================\n\n";
+        for (const auto& image : pages.images) {
+            file << image << "\n";
+        }
+        return static_cast<bool>(file);
+    }
+    
+    static std::string manifestName(size_t position, size_t total) {
+        size_t width = std::max<size_t>(4, std::to_string(total).size());
+        std::ostringstream name;
+        name << std::setw(static_cast<int>(width)) << std::setfill('0') << position << ".txt";
+        return name.str();
+    }
+
+private:
+    // Own queue first (front), then steal from the others (back)
+    bool take(std::vector<std::unique_ptr<WorkQueue>>& queues, size_t self, size_t& index) {
+        for (size_t k = 0; k < queues.size(); ++k) {
+            WorkQueue& queue = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            
+            if (k == 0) {
+                index = queue.tasks.front();
+                queue.tasks.pop_front();
+            } else {
+                index = queue.tasks.back();
+                queue.tasks.pop_back();
+                ++steals_;
+            }
+            return true;
+        }
+        return false;
+    }
+    
+    ChapterPages fetchChapter(const std::string& url) {
+        ChapterPages pages;
+        pages.url = url;
+        
+        try {
+            HTTPResponse response = client_.get(url);
+            if (!response.success) {
+                pages.error = response.error_message;
+                return pages;
+            }
+            
+            HTMLParser parser(response.body());
+            std::unordered_set<std::string> seen;
+            for (const auto& element : parser.select(*images_)) {
+                std::string_view source = imageSource(element);
+                if (source.empty()) continue;
+                
+                std::string image = URLUtils::resolve(url, source);
+                if (seen.insert(image).second) {
+                    pages.images.push_back(std::move(image));
+                }
+            }
+            pages.success = true;
+        } catch (const std::exception& e) {
+            pages.error = e.what();
+        }
+        return pages;
+    }
+    
+    // Lazy-loading readers keep the real URL in a data attribute and a placeholder in src
+    static std::string_view imageSource(const HTMLElement& element) {
+        for (const char* attribute : {"data-src", "data-lazy-src", "src"}) {
+            std::string_view value = StringUtils::trimmed(element.attribute(attribute));
+            if (!value.empty() && value.compare(0, 5, "data:") != 0) {
+                return value;
+            }
+        }
+        return {};
+    }
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "string_utils.hpp"
+#include "url_utils.hpp"
+
+// ============================================================================
+// CHAPTER INDEX
+// ============================================================================
+
+// Chapter URLs already seen for one series, persisted between runs so a
+// re-scrape can report just the chapters that were added or removed
+class ChapterIndex {
+public:
+    enum class LoadResult { Loaded, Missing, OtherSource };
+    
+    struct Delta {
+        std::vector<std::string> added;   // In the order of the list passed to diff()
+        std::vector<std::string> removed; // Only filled when the full list was seen
+    };
+    
+private:
+    std::string path_;
+    std::string source_;
+    std::string title_;
+    std::vector<std::string> chapters_;
+    std::unordered_set<std::string> known_;
+    bool loaded_ = false;
+    
+public:
+    explicit ChapterIndex(std::string path = "") : path_(std::move(path)) {}
+    
+    const std::string& path() const { return path_; }
+    const std::string& title() const { return title_; }
+    const std::vector<std::string>& chapters() const { return chapters_; }
+    bool loaded() const { return loaded_; }
+    size_t size() const { return chapters_.size(); }
+    
+    // OtherSource leaves the index empty, so every chapter counts as new.
+    // `from` reads an index kept elsewhere; save() still writes to path().
+    LoadResult load(const std::string& source) { return load(source, path_); }
+    
+    LoadResult load(const std::string& source, const std::string& from) {
+        std::ifstream file(from);
+        if (!file.is_open()) return LoadResult::Missing;
+        
+        std::string line;
+        std::string indexSource;
+        std::string title;
+        std::vector<std::string> chapters;
+        while (std::getline(file, line)) {
+            if (line.empty()) continue;
+            if (line.front() == '#') {
+                readHeader(line, "# Source: ", indexSource);
+                readHeader(line, "# Title: ", title);
+                continue;
+            }
+            chapters.push_back(line);
+        }
+        
+        if (URLUtils::normalize(indexSource) != URLUtils::normalize(source)) return LoadResult::OtherSource;
+        
+        source_ = indexSource;
+        title_ = title;
+        chapters_ = std::move(chapters);
+        known_ = std::unordered_set<std::string>(chapters_.begin(), chapters_.end());
+        loaded_ = true;
+        return LoadResult::Loaded;
+    }
+    
+    bool contains(const std::string& url) const {
+        return known_.count(url) > 0;
+    }
+    
+    // `complete` is false when extraction stopped early, in which case
+    // missing chapters cannot be told apart from unread ones
+    Delta diff(const std::vector<std::string>& current, bool complete) const {
+        Delta delta;
+        std::unordered_set<std::string> seen;
+        seen.reserve(current.size());
+        
+        for (const auto& url : current) {
+            if (seen.insert(url).second && !contains(url)) {
+                delta.added.push_back(url);
+            }
+        }
+        if (complete) {
+            for (const auto& url : chapters_) {
+                if (!seen.count(url)) {
+                    delta.removed.push_back(url);
+                }
+            }
+        }
+        return delta;
+    }
+    
+    // Writes via a temporary file so an interrupted run never leaves a truncated index
+    bool save(const std::string& source, const std::string& title,
+              const std::vector<std::string>& chapters, const std::string& timestamp) const {
+        std::string temp = path_ + ".tmp";
+        {
+            std::ofstream file(temp);
+            if (!file.is_open()) return false;
+            
+            file << "# Linkex Chapter Index\n";
+            file << "# Title: " << title << "\n";
+            file << "# Source: " << source << "\n";
+            file << "# Total Chapters: " << chapters.size() << "\n";
+            file << "# Updated: " << timestamp << "\n";
+            for (const auto& url : chapters) {
+                file << url << "\n";
+            }
+            if (!file.good()) return false;
+        }
+        return std::rename(temp.c_str(), path_.c_str()) == 0;
+    }
+    
+private:
+    static void readHeader(const std::string& line, const std::string& prefix, std::string& value) {
+        if (line.compare(0, prefix.size(), prefix) == 0) {
+            value = StringUtils::trim(line.substr(prefix.size()));
+        }
+    }
+};
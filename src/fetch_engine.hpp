@@ -0,0 +1,291 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <curl/curl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#ifdef LINKEX_COROUTINES
+#include <coroutine>
+#include <exception>
+#endif
+
+// ============================================================================
+// FETCH ENGINE
+// ============================================================================
+
+// Drives any number of curl easy handles from one thread: a multi handle in
+// socket mode reports which sockets to watch, epoll waits on them, and curl's
+// timer and our own scheduled tasks set the epoll timeout. Transfers cost a
+// handle and a buffer each instead of a blocked thread.
+//
+// post() may be called from any thread; add() and schedule() only from tasks
+// and callbacks, which all run on the loop thread and must not block.
+class FetchEngine {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+    using Completion = std::function<void(CURLcode)>;
+    
+    struct Stats {
+        size_t transfers = 0;  // Completed
+        size_t peakActive = 0; // Most transfers in flight at once
+    };
+
+private:
+    struct Timer {
+        Clock::time_point due;
+        size_t sequence; // Keeps tasks due at the same time in scheduling order
+        Task task;
+        
+        bool operator>(const Timer& other) const {
+            return due != other.due ? due > other.due : sequence > other.sequence;
+        }
+    };
+    
+    CURLM* multi_;
+    int epoll_ = -1;
+    int wake_ = -1; // eventfd written by post()
+    
+    std::mutex postedMutex_;
+    std::vector<Task> posted_;
+    
+    std::unordered_map<CURL*, Completion> transfers_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    size_t timerSequence_ = 0;
+    bool curlTimerSet_ = false;
+    Clock::time_point curlDeadline_;
+    
+    std::atomic<bool> stopping_{false};
+    std::atomic<size_t> transfersDone_{0};
+    std::atomic<size_t> peakActive_{0};
+    std::thread thread_;
+    
+    // curl asks to watch, re-watch or forget a socket
+    static int SocketCallback(CURL*, curl_socket_t fd, int what, void* engine, void* watched) {
+        FetchEngine* self = static_cast<FetchEngine*>(engine);
+        if (what == CURL_POLL_REMOVE) {
+            epoll_ctl(self->epoll_, EPOLL_CTL_DEL, fd, nullptr);
+            return 0;
+        }
+        
+        epoll_event event{};
+        event.data.fd = fd;
+        event.events = ((what & CURL_POLL_IN) ? EPOLLIN : 0u) | ((what & CURL_POLL_OUT) ? EPOLLOUT : 0u);
+        int op = watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        if (epoll_ctl(self->epoll_, op, fd, &event) != 0) {
+            // The descriptor was closed and reused behind curl's back
+            epoll_ctl(self->epoll_, op == EPOLL_CTL_ADD ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event);
+        }
+        if (!watched) curl_multi_assign(self->multi_, fd, self);
+        return 0;
+    }
+    
+    static int TimerCallback(CURLM*, long timeoutMs, void* engine) {
+        FetchEngine* self = static_cast<FetchEngine*>(engine);
+        self->curlTimerSet_ = timeoutMs >= 0;
+        self->curlDeadline_ = Clock::now() + std::chrono::milliseconds(std::max(0L, timeoutMs));
+        return 0;
+    }
+
+public:
+    FetchEngine() : multi_(curl_multi_init()) {
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (!multi_ || epoll_ < 0 || wake_ < 0) {
+            if (multi_) curl_multi_cleanup(multi_);
+            if (epoll_ >= 0) ::close(epoll_);
+            if (wake_ >= 0) ::close(wake_);
+            throw std::runtime_error("Failed to initialize the fetch event loop");
+        }
+        
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = wake_;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &event);
+        
+        curl_multi_setopt(multi_, CURLMOPT_SOCKETFUNCTION, SocketCallback);
+        curl_multi_setopt(multi_, CURLMOPT_SOCKETDATA, this);
+        curl_multi_setopt(multi_, CURLMOPT_TIMERFUNCTION, TimerCallback);
+        curl_multi_setopt(multi_, CURLMOPT_TIMERDATA, this);
+        curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, 256L);
+        
+        thread_ = std::thread([this] { run(); });
+    }
+    
+    // Transfers still running are completed with CURLE_ABORTED_BY_CALLBACK, then
+    // posted and scheduled tasks run at once, due or not, so whatever they carry
+    // gets settled. They must notice the shutdown instead of scheduling more work.
+    ~FetchEngine() {
+        stopping_ = true;
+        wake();
+        thread_.join();
+        
+        std::unordered_map<CURL*, Completion> aborted;
+        aborted.swap(transfers_);
+        for (auto& transfer : aborted) {
+            curl_multi_remove_handle(multi_, transfer.first);
+            transfer.second(CURLE_ABORTED_BY_CALLBACK);
+        }
+        while (runPosted() + runTimers(Clock::time_point::max()) > 0) {}
+        curl_multi_cleanup(multi_);
+        ::close(epoll_);
+        ::close(wake_);
+    }
+    
+    FetchEngine(const FetchEngine&) = delete;
+    FetchEngine& operator=(const FetchEngine&) = delete;
+    
+    // Runs `task` on the loop thread
+    void post(Task task) {
+        {
+            std::lock_guard<std::mutex> lock(postedMutex_);
+            posted_.push_back(std::move(task));
+        }
+        wake();
+    }
+    
+    // Starts a configured easy handle; `done` gets its result once it finishes.
+    // The handle belongs to the engine until then.
+    void add(CURL* easy, Completion done) {
+        if (stopping_) {
+            done(CURLE_ABORTED_BY_CALLBACK);
+            return;
+        }
+        CURLMcode code = curl_multi_add_handle(multi_, easy);
+        if (code != CURLM_OK) {
+            done(CURLE_FAILED_INIT);
+            return;
+        }
+        transfers_.emplace(easy, std::move(done));
+        if (transfers_.size() > peakActive_) peakActive_ = transfers_.size();
+    }
+    
+    void schedule(Clock::duration delay, Task task) {
+        timers_.push(Timer{Clock::now() + delay, timerSequence_++, std::move(task)});
+    }
+    
+    Stats stats() const {
+        Stats s;
+        s.transfers = transfersDone_;
+        s.peakActive = peakActive_;
+        return s;
+    }
+
+private:
+    void wake() {
+        uint64_t one = 1;
+        ssize_t written = ::write(wake_, &one, sizeof(one));
+        (void)written; // Only fails when the counter is already non-zero
+    }
+    
+    void run() {
+        std::vector<epoll_event> events(256);
+        int running = 0;
+        
+        while (!stopping_) {
+            int ready = epoll_wait(epoll_, events.data(), static_cast<int>(events.size()), waitMillis());
+            
+            for (int i = 0; i < ready; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == wake_) {
+                    uint64_t count;
+                    while (::read(wake_, &count, sizeof(count)) > 0) {}
+                    continue;
+                }
+                int flags = 0;
+                if (events[i].events & EPOLLIN) flags |= CURL_CSELECT_IN;
+                if (events[i].events & EPOLLOUT) flags |= CURL_CSELECT_OUT;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) flags |= CURL_CSELECT_ERR;
+                curl_multi_socket_action(multi_, fd, flags, &running);
+            }
+            
+            if (curlTimerSet_ && Clock::now() >= curlDeadline_) {
+                curlTimerSet_ = false;
+                curl_multi_socket_action(multi_, CURL_SOCKET_TIMEOUT, 0, &running);
+            }
+            
+            completeTransfers();
+            runTimers();
+            runPosted();
+        }
+    }
+    
+    // Milliseconds until curl's deadline or the next scheduled task, -1 for none
+    int waitMillis() const {
+        bool any = curlTimerSet_ || !timers_.empty();
+        if (!any) return -1;
+        Clock::time_point due = Clock::time_point::max();
+        if (curlTimerSet_) due = curlDeadline_;
+        if (!timers_.empty()) due = std::min(due, timers_.top().due);
+        
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(due - Clock::now()).count();
+        return static_cast<int>(std::clamp<long long>(wait, 0, 60 * 1000));
+    }
+    
+    void completeTransfers() {
+        int queued = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi_, &queued)) {
+            if (message->msg != CURLMSG_DONE) continue;
+            CURL* easy = message->easy_handle;
+            CURLcode result = message->data.result;
+            curl_multi_remove_handle(multi_, easy);
+            
+            auto it = transfers_.find(easy);
+            if (it == transfers_.end()) continue;
+            Completion done = std::move(it->second);
+            transfers_.erase(it);
+            ++transfersDone_;
+            done(result);
+        }
+    }
+    
+    // Both return how many tasks they ran
+    size_t runTimers(Clock::time_point now = Clock::now()) {
+        size_t ran = 0;
+        while (!timers_.empty() && timers_.top().due <= now) {
+            Task task = std::move(const_cast<Timer&>(timers_.top()).task);
+            timers_.pop();
+            task();
+            ++ran;
+        }
+        return ran;
+    }
+    
+    size_t runPosted() {
+        std::vector<Task> tasks;
+        {
+            std::lock_guard<std::mutex> lock(postedMutex_);
+            tasks.swap(posted_);
+        }
+        for (Task& task : tasks) {
+            task();
+        }
+        return tasks.size();
+    }
+};
+
+#ifdef LINKEX_COROUTINES
+// Return type for fire-and-forget coroutines: starts at once and frees its frame
+// when it finishes. Whatever waits on the result has to be told by the coroutine.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+#endif
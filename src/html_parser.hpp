@@ -0,0 +1,602 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <strings.h>
+#include <gumbo.h>
+
+#include "page_scanner.hpp"
+
+// ============================================================================
+// HTML PARSER
+// ============================================================================
+
+class HTMLElement {
+private:
+    GumboNode* node_;
+    
+public:
+    HTMLElement(GumboNode* node) : node_(node) {}
+    
+    // Points into the parser's tree: valid only while the HTMLParser lives.
+    // Empty if the attribute is missing.
+    std::string_view attribute(std::string_view name) const {
+        if (node_->type != GUMBO_NODE_ELEMENT) return {};
+        
+        const GumboVector& attributes = node_->v.element.attributes;
+        for (unsigned int i = 0; i < attributes.length; ++i) {
+            auto* attr = static_cast<const GumboAttribute*>(attributes.data[i]);
+            if (strncasecmp(attr->name, name.data(), name.size()) == 0 && attr->name[name.size()] == '\0') {
+                return attr->value;
+            }
+        }
+        return {};
+    }
+    
+    std::string getAttribute(std::string_view name) const {
+        return std::string(attribute(name));
+    }
+    
+    std::string getText() const {
+        std::string text;
+        appendText(text);
+        return text;
+    }
+    
+    // Appends the text of every descendant text node to `out`, in document order
+    void appendText(std::string& out) const {
+        appendTextContent(node_, out);
+    }
+    
+private:
+    static void appendTextContent(const GumboNode* node, std::string& out) {
+        if (node->type == GUMBO_NODE_TEXT) {
+            out += node->v.text.text;
+        } else if (node->type == GUMBO_NODE_ELEMENT) {
+            const GumboVector* children = &node->v.element.children;
+            for (unsigned int i = 0; i < children->length; ++i) {
+                appendTextContent(static_cast<const GumboNode*>(children->data[i]), out);
+            }
+        }
+    }
+};
+
+// Compiled CSS selector. Supports type, universal, #id, .class and [attr]
+// ([attr=v], [attr^=v], [attr$=v], [attr*=v]) simple selectors, the
+// :first-child, :last-child and :nth-child(n) pseudo-classes, descendant and
+// child combinators, and comma-separated selector lists. Matching walks up the
+// parent chain from the candidate node and never allocates.
+class CSSSelector {
+private:
+    enum class Combinator { None, Descendant, Child };
+    enum class AttrOp { Exists, Equals, Prefix, Suffix, Contains };
+    
+    struct AttrTest {
+        std::string name;
+        AttrOp op = AttrOp::Exists;
+        std::string value;
+    };
+    
+    struct Compound {
+        Combinator combinator = Combinator::None; // Relation to the compound on its left
+        bool anyTag = true;
+        GumboTag tag = GUMBO_TAG_UNKNOWN;
+        std::string tagName;                      // Only compared for tags Gumbo does not know
+        std::string id;
+        std::vector<std::string> classes;
+        std::vector<AttrTest> attributes;
+        int nthChild = 0;                         // 1-based, 0 = unconstrained
+        bool lastChild = false;
+    };
+    
+    using Complex = std::vector<Compound>;
+    
+    std::string text_;
+    std::vector<Complex> alternatives_;
+    
+public:
+    CSSSelector() = default;
+    
+    // Throws std::invalid_argument on syntax outside the supported subset
+    explicit CSSSelector(const std::string& text) : text_(text) {
+        size_t pos = 0;
+        alternatives_.push_back(parseComplex(pos));
+        while (pos < text_.size()) {
+            if (text_[pos] != ',') fail("unexpected '" + std::string(1, text_[pos]) + "'", pos);
+            ++pos;
+            alternatives_.push_back(parseComplex(pos));
+        }
+    }
+    
+    const std::string& text() const { return text_; }
+    bool empty() const { return alternatives_.empty(); }
+    
+    bool matches(const GumboNode* node) const {
+        if (node->type != GUMBO_NODE_ELEMENT && node->type != GUMBO_NODE_TEMPLATE) return false;
+        for (const auto& complex : alternatives_) {
+            if (matchFrom(complex, complex.size() - 1, node)) return true;
+        }
+        return false;
+    }
+    
+    // Id of the leftmost compound when there is a single alternative, e.g.
+    // "chapters-list" for "#chapters-list li > a"; empty otherwise
+    std::string leadingId() const {
+        return alternatives_.size() == 1 ? alternatives_.front().front().id : std::string();
+    }
+    
+    // leadingId() when matching needs nothing outside that element: its
+    // compound tests no position among siblings. Empty otherwise.
+    std::string scopeId() const {
+        if (alternatives_.size() != 1) return "";
+        const Compound& leading = alternatives_.front().front();
+        return leading.nthChild == 0 && !leading.lastChild ? leading.id : std::string();
+    }
+    
+private:
+    [[noreturn]] void fail(const std::string& reason, size_t pos) const {
+        throw std::invalid_argument("Invalid selector \"" + text_ + "\" at " + std::to_string(pos) + ": " + reason);
+    }
+    
+    static bool isNameChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' ||
+               static_cast<unsigned char>(c) >= 0x80;
+    }
+    
+    void skipSpaces(size_t& pos) const {
+        while (pos < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos]))) ++pos;
+    }
+    
+    std::string readName(size_t& pos) const {
+        size_t start = pos;
+        while (pos < text_.size() && isNameChar(text_[pos])) ++pos;
+        if (pos == start) fail("expected a name", pos);
+        return text_.substr(start, pos - start);
+    }
+    
+    Complex parseComplex(size_t& pos) const {
+        Complex complex;
+        skipSpaces(pos);
+        complex.push_back(parseCompound(pos));
+        
+        while (true) {
+            size_t before = pos;
+            skipSpaces(pos);
+            if (pos >= text_.size() || text_[pos] == ',') break;
+            
+            Combinator combinator = Combinator::Descendant;
+            if (text_[pos] == '>') {
+                combinator = Combinator::Child;
+                ++pos;
+                skipSpaces(pos);
+            } else if (text_[pos] == '+' || text_[pos] == '~') {
+                fail("sibling combinators are not supported", pos);
+            } else if (pos == before) {
+                fail("unexpected '" + std::string(1, text_[pos]) + "'", pos);
+            }
+            
+            Compound compound = parseCompound(pos);
+            compound.combinator = combinator;
+            complex.push_back(std::move(compound));
+        }
+        return complex;
+    }
+    
+    Compound parseCompound(size_t& pos) const {
+        Compound compound;
+        size_t start = pos;
+        
+        if (pos < text_.size() && text_[pos] == '*') {
+            ++pos;
+        } else if (pos < text_.size() && isNameChar(text_[pos])) {
+            std::string name = readName(pos);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            compound.anyTag = false;
+            compound.tag = gumbo_tag_enum(name.c_str());
+            compound.tagName = name;
+        }
+        
+        while (pos < text_.size()) {
+            char c = text_[pos];
+            if (c == '#') {
+                ++pos;
+                compound.id = readName(pos);
+            } else if (c == '.') {
+                ++pos;
+                compound.classes.push_back(readName(pos));
+            } else if (c == '[') {
+                compound.attributes.push_back(parseAttribute(++pos));
+            } else if (c == ':') {
+                parsePseudoClass(++pos, compound);
+            } else {
+                break;
+            }
+        }
+        
+        if (pos == start) fail("expected a selector", pos);
+        return compound;
+    }
+    
+    AttrTest parseAttribute(size_t& pos) const {
+        AttrTest test;
+        skipSpaces(pos);
+        test.name = readName(pos);
+        std::transform(test.name.begin(), test.name.end(), test.name.begin(), ::tolower);
+        skipSpaces(pos);
+        
+        if (pos < text_.size() && text_[pos] != ']') {
+            static const std::pair<const char*, AttrOp> operators[] = {
+                {"=", AttrOp::Equals}, {"^=", AttrOp::Prefix}, {"$=", AttrOp::Suffix}, {"*=", AttrOp::Contains}
+            };
+            bool found = false;
+            for (const auto& op : operators) {
+                size_t len = std::strlen(op.first);
+                if (text_.compare(pos, len, op.first) == 0) {
+                    test.op = op.second;
+                    pos += len;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) fail("unsupported attribute operator", pos);
+            
+            skipSpaces(pos);
+            if (pos < text_.size() && (text_[pos] == '"' || text_[pos] == '\'')) {
+                char quote = text_[pos++];
+                size_t end = text_.find(quote, pos);
+                if (end == std::string::npos) fail("unterminated string", pos);
+                test.value = text_.substr(pos, end - pos);
+                pos = end + 1;
+            } else {
+                test.value = readName(pos);
+            }
+            skipSpaces(pos);
+        }
+        
+        if (pos >= text_.size() || text_[pos] != ']') fail("expected ']'", pos);
+        ++pos;
+        return test;
+    }
+    
+    void parsePseudoClass(size_t& pos, Compound& compound) const {
+        std::string name = readName(pos);
+        if (name == "first-child") {
+            compound.nthChild = 1;
+        } else if (name == "last-child") {
+            compound.lastChild = true;
+        } else if (name == "nth-child") {
+            if (pos >= text_.size() || text_[pos] != '(') fail("expected '('", pos);
+            size_t end = text_.find(')', ++pos);
+            if (end == std::string::npos) fail("expected ')'", pos);
+            std::string arg = text_.substr(pos, end - pos);
+            try {
+                size_t used = 0;
+                compound.nthChild = std::stoi(arg, &used);
+                if (used != arg.size() || compound.nthChild < 1) throw std::invalid_argument(arg);
+            } catch (const std::exception&) {
+                fail("only :nth-child(<positive integer>) is supported", pos);
+            }
+            pos = end + 1;
+        } else {
+            fail("unsupported pseudo-class :" + name, pos);
+        }
+    }
+    
+    static const GumboNode* parentElement(const GumboNode* node) {
+        const GumboNode* parent = node->parent;
+        if (!parent || (parent->type != GUMBO_NODE_ELEMENT && parent->type != GUMBO_NODE_TEMPLATE)) return nullptr;
+        return parent;
+    }
+    
+    bool matchFrom(const Complex& complex, size_t index, const GumboNode* node) const {
+        const Compound& compound = complex[index];
+        if (!matchesCompound(compound, node)) return false;
+        if (index == 0) return true;
+        
+        if (compound.combinator == Combinator::Child) {
+            const GumboNode* parent = parentElement(node);
+            return parent && matchFrom(complex, index - 1, parent);
+        }
+        for (const GumboNode* ancestor = parentElement(node); ancestor; ancestor = parentElement(ancestor)) {
+            if (matchFrom(complex, index - 1, ancestor)) return true;
+        }
+        return false;
+    }
+    
+    static bool hasClass(const char* classList, const std::string& name) {
+        for (const char* p = classList; *p;) {
+            while (*p && std::isspace(static_cast<unsigned char>(*p))) ++p;
+            const char* start = p;
+            while (*p && !std::isspace(static_cast<unsigned char>(*p))) ++p;
+            if (static_cast<size_t>(p - start) == name.size() && std::strncmp(start, name.c_str(), name.size()) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    static bool matchesAttribute(const AttrTest& test, const char* value) {
+        size_t len = std::strlen(value);
+        switch (test.op) {
+            case AttrOp::Exists:   return true;
+            case AttrOp::Equals:   return test.value == value;
+            case AttrOp::Prefix:   return len >= test.value.size() && std::strncmp(value, test.value.c_str(), test.value.size()) == 0;
+            case AttrOp::Suffix:   return len >= test.value.size() && test.value.compare(0, std::string::npos, value + len - test.value.size()) == 0;
+            case AttrOp::Contains: return std::strstr(value, test.value.c_str()) != nullptr;
+        }
+        return false;
+    }
+    
+    static bool matchesTagName(const Compound& compound, const GumboElement& element) {
+        if (compound.tag != GUMBO_TAG_UNKNOWN) return element.tag == compound.tag;
+        if (element.tag != GUMBO_TAG_UNKNOWN) return false;
+        
+        GumboStringPiece name = element.original_tag;
+        gumbo_tag_from_original_text(&name);
+        return name.length == compound.tagName.size() &&
+               strncasecmp(name.data, compound.tagName.c_str(), name.length) == 0;
+    }
+    
+    static bool matchesPosition(const Compound& compound, const GumboNode* node) {
+        const GumboNode* parent = node->parent;
+        if (!parent) return false;
+        const GumboVector& siblings = parent->type == GUMBO_NODE_DOCUMENT
+            ? parent->v.document.children : parent->v.element.children;
+        
+        if (compound.nthChild > 0) {
+            int position = 0;
+            for (size_t i = 0; i <= node->index_within_parent && i < siblings.length; ++i) {
+                const GumboNode* sibling = static_cast<const GumboNode*>(siblings.data[i]);
+                if (sibling->type == GUMBO_NODE_ELEMENT || sibling->type == GUMBO_NODE_TEMPLATE) ++position;
+            }
+            if (position != compound.nthChild) return false;
+        }
+        if (compound.lastChild) {
+            for (size_t i = node->index_within_parent + 1; i < siblings.length; ++i) {
+                const GumboNode* sibling = static_cast<const GumboNode*>(siblings.data[i]);
+                if (sibling->type == GUMBO_NODE_ELEMENT || sibling->type == GUMBO_NODE_TEMPLATE) return false;
+            }
+        }
+        return true;
+    }
+    
+    static bool matchesCompound(const Compound& compound, const GumboNode* node) {
+        const GumboElement& element = node->v.element;
+        if (!compound.anyTag && !matchesTagName(compound, element)) return false;
+        
+        if (!compound.id.empty()) {
+            GumboAttribute* id = gumbo_get_attribute(&element.attributes, "id");
+            if (!id || compound.id != id->value) return false;
+        }
+        if (!compound.classes.empty()) {
+            GumboAttribute* classAttr = gumbo_get_attribute(&element.attributes, "class");
+            if (!classAttr) return false;
+            for (const auto& name : compound.classes) {
+                if (!hasClass(classAttr->value, name)) return false;
+            }
+        }
+        for (const auto& test : compound.attributes) {
+            GumboAttribute* attr = gumbo_get_attribute(&element.attributes, test.name.c_str());
+            if (!attr || !matchesAttribute(test, attr->value)) return false;
+        }
+        if ((compound.nthChild > 0 || compound.lastChild) && !matchesPosition(compound, node)) return false;
+        return true;
+    }
+};
+
+// Bump allocator for Gumbo trees. Allocation advances a pointer through
+// fixed-size chunks and frees are no-ops; reset() rewinds to the first chunk so
+// the next page reuses the same memory. One per thread, so parsing in many
+// workers never contends on malloc.
+class ParseArena {
+private:
+    static constexpr size_t kAlignment = alignof(std::max_align_t);
+    static constexpr size_t kRetainedChunks = 16; // Kept across resets, beyond that memory goes back
+    
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    
+    std::vector<Chunk> chunks_;
+    size_t current_ = 0; // Chunk being filled
+    size_t used_ = 0;    // Bytes taken from it
+    size_t chunkSize_;
+    size_t live_ = 0;    // Parsers whose trees point into the arena
+    
+public:
+    explicit ParseArena(size_t chunkSize = 1 << 20) : chunkSize_(chunkSize) {}
+    
+    ParseArena(const ParseArena&) = delete;
+    ParseArena& operator=(const ParseArena&) = delete;
+    
+    static ParseArena& forThisThread() {
+        thread_local ParseArena arena;
+        return arena;
+    }
+    
+    void* allocate(size_t size) {
+        size = (size + kAlignment - 1) & ~(kAlignment - 1);
+        for (; current_ < chunks_.size(); ++current_, used_ = 0) {
+            Chunk& chunk = chunks_[current_];
+            if (chunk.size - used_ >= size) {
+                void* block = chunk.data.get() + used_;
+                used_ += size;
+                return block;
+            }
+        }
+        
+        // Oversized requests get a chunk of their own
+        size_t chunkSize = std::max(chunkSize_, size);
+        chunks_.push_back(Chunk{std::unique_ptr<char[]>(new char[chunkSize]), chunkSize});
+        used_ = size;
+        return chunks_.back().data.get();
+    }
+    
+    // Invalidates everything allocated so far
+    void reset() {
+        chunks_.erase(std::remove_if(chunks_.begin(), chunks_.end(),
+                                     [this](const Chunk& chunk) { return chunk.size != chunkSize_; }),
+                      chunks_.end());
+        if (chunks_.size() > kRetainedChunks) chunks_.resize(kRetainedChunks);
+        current_ = 0;
+        used_ = 0;
+    }
+    
+    // The first parser to start on an idle arena recycles it
+    void retain() {
+        if (live_++ == 0) reset();
+    }
+    
+    void release() { --live_; }
+    
+    size_t capacity() const {
+        size_t total = 0;
+        for (const auto& chunk : chunks_) total += chunk.size;
+        return total;
+    }
+    
+    static void* gumboAllocate(void* userdata, size_t size) {
+        return static_cast<ParseArena*>(userdata)->allocate(size);
+    }
+    
+    static void gumboFree(void*, void*) {}
+};
+
+class HTMLParser {
+private:
+    ParseArena& arena_;
+    GumboOutput* output_;
+    
+    std::string fragment_; // Scoped parses only: the page ranges the tree was built from
+    
+public:
+    // The tree lives in the calling thread's arena, so the parser must be
+    // destroyed on the thread that created it
+    HTMLParser(std::string_view html) : arena_(ParseArena::forThisThread()) {
+        parse(html, false);
+    }
+    
+    // Builds the tree from just the elements carrying `scopeIds` (and any
+    // <base>), parsed as a <body> fragment, when PageScanner can delimit them;
+    // from the whole page otherwise. Selectors whose scopeId() is among them
+    // match the same elements either way.
+    HTMLParser(std::string_view html, const std::vector<std::string>& scopeIds)
+        : arena_(ParseArena::forThisThread()) {
+        std::vector<PageScanner::Range> ranges;
+        if (!PageScanner::scan(html, scopeIds, ranges)) {
+            parse(html, false);
+            return;
+        }
+        size_t size = 0;
+        for (const auto& range : ranges) size += range.end - range.begin;
+        fragment_.reserve(size);
+        for (const auto& range : ranges) fragment_.append(html.substr(range.begin, range.end - range.begin));
+        parse(fragment_, true);
+    }
+    
+    // No gumbo_destroy_output(): the arena takes the whole tree back at once
+    ~HTMLParser() { arena_.release(); }
+    
+    HTMLParser(const HTMLParser&) = delete;
+    HTMLParser& operator=(const HTMLParser&) = delete;
+    
+    bool scoped() const { return !fragment_.empty(); }
+    
+    std::vector<HTMLElement> select(const std::string& selector) {
+        return select(CSSSelector(selector));
+    }
+    
+    std::vector<HTMLElement> select(const CSSSelector& selector) {
+        return std::move(select(std::vector<const CSSSelector*>{&selector}).front());
+    }
+    
+    // Answers every selector in one traversal; results[i] holds the matches
+    // of selectors[i] in document order
+    std::vector<std::vector<HTMLElement>> select(const std::vector<const CSSSelector*>& selectors) {
+        std::vector<std::vector<HTMLElement>> results(selectors.size());
+        collectMatches(output_->root, selectors, results);
+        return results;
+    }
+    
+private:
+    void parse(std::string_view html, bool fragment) {
+        GumboOptions options = kGumboDefaultOptions;
+        options.allocator = &ParseArena::gumboAllocate;
+        options.deallocator = &ParseArena::gumboFree;
+        options.userdata = &arena_;
+        if (fragment) {
+            options.fragment_context = GUMBO_TAG_BODY;
+            options.fragment_namespace = GUMBO_NAMESPACE_HTML;
+        }
+        
+        arena_.retain();
+        output_ = gumbo_parse_with_options(&options, html.data(), html.size());
+        if (!output_) {
+            arena_.release();
+            throw std::runtime_error("Failed to parse HTML");
+        }
+    }
+    
+    void collectMatches(GumboNode* node, const std::vector<const CSSSelector*>& selectors,
+                        std::vector<std::vector<HTMLElement>>& results) {
+        if (node->type != GUMBO_NODE_ELEMENT && node->type != GUMBO_NODE_TEMPLATE) return;
+        
+        for (size_t i = 0; i < selectors.size(); ++i) {
+            if (selectors[i]->matches(node)) {
+                results[i].emplace_back(node);
+            }
+        }
+        
+        GumboVector* children = &node->v.element.children;
+        for (unsigned int i = 0; i < children->length; ++i) {
+            collectMatches(static_cast<GumboNode*>(children->data[i]), selectors, results);
+        }
+    }
+};
+
+// Chapter-link and title selectors for one site layout, compiled once and
+// shared by every scrape that uses them
+struct PageSelectors {
+    std::vector<CSSSelector> chapterLinks; // Tried in order until one matches
+    CSSSelector title;
+    std::vector<std::string> scopeIds;     // Containers of every match, empty if a selector reaches outside one
+    
+    static std::shared_ptr<const PageSelectors> compile(const std::vector<std::string>& chapterLinks,
+                                                        const std::string& title) {
+        auto selectors = std::make_shared<PageSelectors>();
+        for (const auto& text : chapterLinks) {
+            selectors->chapterLinks.emplace_back(text);
+        }
+        selectors->title = CSSSelector(title);
+        
+        std::vector<const CSSSelector*> all;
+        for (const auto& selector : selectors->chapterLinks) all.push_back(&selector);
+        all.push_back(&selectors->title);
+        for (const CSSSelector* selector : all) {
+            std::string id = selector->scopeId();
+            if (id.empty()) {
+                selectors->scopeIds.clear();
+                break;
+            }
+            if (std::find(selectors->scopeIds.begin(), selectors->scopeIds.end(), id) == selectors->scopeIds.end()) {
+                selectors->scopeIds.push_back(std::move(id));
+            }
+        }
+        return selectors;
+    }
+    
+    static std::shared_ptr<const PageSelectors> defaults() {
+        static const std::shared_ptr<const PageSelectors> selectors = compile(
+            {"#chapters-list li > a", "#chapters-list a"}, "#manga-info-rightColumn h1");
+        return selectors;
+    }
+};
@@ -0,0 +1,1076 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cctype>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <curl/curl.h>
+
+#include "fetch_engine.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "rate_limiter.hpp"
+#include "response_cache.hpp"
+#include "retry_policy.hpp"
+#include "traffic_archive.hpp"
+#include "url_utils.hpp"
+
+// ============================================================================
+// HTTP CLIENT
+// ============================================================================
+
+// Recycles response body buffers, so a long run reuses a few large allocations
+// instead of growing a fresh string for every page
+class ReceiveBufferPool {
+public:
+    static constexpr size_t kMaxCapacity = 32 * 1024 * 1024; // Larger outliers are not kept, nor presized
+
+private:
+    static constexpr size_t kMaxBuffers = 32;
+    static constexpr size_t kMinCapacity = 16 * 1024;        // Smaller ones are not worth keeping
+    
+    std::mutex mutex_;
+    std::vector<std::string> buffers_;
+    std::atomic<size_t> reused_{0};
+
+public:
+    // An empty string, with capacity left over from an earlier response if one is free
+    std::string acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (buffers_.empty()) return std::string();
+        
+        std::string buffer = std::move(buffers_.back());
+        buffers_.pop_back();
+        ++reused_;
+        return buffer;
+    }
+    
+    void release(std::string&& buffer) {
+        if (buffer.capacity() < kMinCapacity || buffer.capacity() > kMaxCapacity) return;
+        buffer.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (buffers_.size() < kMaxBuffers) buffers_.push_back(std::move(buffer));
+    }
+    
+    size_t reused() const { return reused_; }
+};
+
+struct HTTPResponse {
+    std::string data;
+    long status_code = 0;
+    bool success = false;
+    std::string error_message;
+    bool stopped_early = false; // Streaming handler ended the transfer before the full body arrived
+    CURLcode curl_code = CURLE_OK;
+    bool from_cache = false;    // Revalidated with 304 Not Modified and served from the response cache
+    std::shared_ptr<const MappedFile> cached_body;
+    std::shared_ptr<const TrafficArchive> archive; // Keeps archived_body mapped
+    std::string_view archived_body;
+    std::map<std::string, std::string> headers; // Final response only, names lowercased
+    size_t decoded_bytes = 0;   // Body bytes after content decoding, including drained error pages
+    double first_byte_seconds = 0.0;
+    double total_seconds = 0.0;
+    std::shared_ptr<ReceiveBufferPool> pool; // Takes `data` back on destruction
+    
+    HTTPResponse() = default;
+    HTTPResponse(const HTTPResponse&) = default;
+    HTTPResponse(HTTPResponse&&) = default;
+    HTTPResponse& operator=(const HTTPResponse&) = default;
+    HTTPResponse& operator=(HTTPResponse&&) = default;
+    
+    ~HTTPResponse() {
+        if (pool) pool->release(std::move(data));
+    }
+    
+    // The response body, wherever it lives
+    std::string_view body() const {
+        if (cached_body) return cached_body->data();
+        return archive ? archived_body : std::string_view(data);
+    }
+    
+    std::string header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it == headers.end() ? "" : it->second;
+    }
+};
+
+struct HTTPClientOptions {
+    std::string cacheDir; // On-disk response cache with ETag/Last-Modified revalidation, empty = off
+    RateLimitOptions rateLimit;
+    RetryOptions retry;
+    std::shared_ptr<Metrics> metrics; // Per-transfer curl timings, null = off
+    std::string recordPath;  // Append every response to this traffic archive
+    std::string replayPath;  // Serve responses from this archive instead of the network
+    bool replayLatency = false; // Wait out the recorded latencies while replaying
+};
+
+class HTTPClient {
+public:
+    // Receives body chunks as they arrive; returning false ends the transfer early
+    using ChunkHandler = std::function<bool(const char* data, size_t size)>;
+    
+    // Receives the finished response of getAsync()
+    using ResponseHandler = std::function<void(HTTPResponse response)>;
+    
+    struct Stats {
+        size_t requests = 0;
+        size_t poolHits = 0;          // Requests served by a pooled easy handle
+        size_t poolMisses = 0;        // Requests that had to create a new easy handle
+        size_t connectionsReused = 0; // Transfers that did not open a new connection
+        size_t connectionsOpened = 0;
+        size_t http2Transfers = 0;
+        size_t retries = 0;
+        size_t hedges = 0;    // Duplicate requests fired after the p95 latency
+        size_t hedgeWins = 0; // Hedges that finished before the original
+        size_t wireBytes = 0;    // Body bytes received, compressed if the server compressed them
+        size_t decodedBytes = 0; // The same bodies after decoding
+        size_t buffersReused = 0;
+        size_t recorded = 0;
+        size_t replayed = 0;
+        size_t replayMisses = 0; // Requests for URLs the replay archive does not have
+        size_t asyncTransfers = 0; // Transfers driven by the event loop
+        size_t peakInFlight = 0;   // Most event loop transfers at once
+    };
+
+private:
+    CURLSH* share_;
+    std::mutex shareLocks_[CURL_LOCK_DATA_LAST];
+    
+    std::mutex poolMutex_;
+    std::vector<CURL*> pool_;
+    
+    std::atomic<size_t> requests_{0};
+    std::atomic<size_t> poolHits_{0};
+    std::atomic<size_t> poolMisses_{0};
+    std::atomic<size_t> connectionsReused_{0};
+    std::atomic<size_t> connectionsOpened_{0};
+    std::atomic<size_t> http2Transfers_{0};
+    std::atomic<size_t> retries_{0};
+    std::atomic<size_t> hedges_{0};
+    std::atomic<size_t> hedgeWins_{0};
+    std::atomic<size_t> wireBytes_{0};
+    std::atomic<size_t> decodedBytes_{0};
+    
+    std::unique_ptr<ResponseCache> cache_;
+    RateLimiter limiter_;
+    RetryPolicy retry_;
+    std::shared_ptr<Metrics> metrics_;
+    LatencyTracker latency_;
+    std::shared_ptr<ReceiveBufferPool> buffers_ = std::make_shared<ReceiveBufferPool>();
+    std::unique_ptr<TrafficRecorder> recorder_;
+    std::shared_ptr<const TrafficArchive> replay_;
+    bool replayLatency_ = false;
+    std::atomic<size_t> replayed_{0};
+    std::atomic<size_t> replayMisses_{0};
+    
+    // Event loop for getAsync(), started on first use
+    std::once_flag engineOnce_;
+    std::atomic<FetchEngine*> engine_{nullptr};
+    std::unique_ptr<FetchEngine> engineOwner_;
+    std::atomic<bool> closing_{false}; // Set by the destructor; requests still waiting are failed
+    
+    // One getAsync() call; it lives on the loop thread from admission through retries
+    struct AsyncRequest {
+        std::string url;
+        std::string host;
+        int timeout = 30;
+        ResponseHandler done;
+        ResponseCache::Entry validators;
+        bool revalidating = false;
+        size_t retry = 0;
+        RateLimiter::Clock::time_point queued;
+        RateLimiter::Permit permit;
+        HTTPResponse response;
+        curl_slist* requestHeaders = nullptr;
+        bool raced = false; // One attempt of a hedge race; get() handles retries, the cache and the archive
+        std::shared_ptr<const std::atomic<bool>> cancelled; // Set once the race has a winner
+    };
+    
+    // Requests whose host window is full, per host in arrival order. Loop thread only.
+    std::unordered_map<std::string, std::deque<std::shared_ptr<AsyncRequest>>> parked_;
+    
+    struct StreamState {
+        const ChunkHandler* handler;
+        CURL* curl;
+        HTTPResponse* response;
+        ResponseCache::Writer* cacheWriter;
+        bool stopped = false;
+        size_t delivered = 0;
+    };
+    
+    // First usable response of an original request and its hedge
+    struct HedgeRace {
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::atomic<bool> cancelled{false};
+        size_t launched = 0;
+        size_t done = 0;
+        std::optional<HTTPResponse> winner;
+        bool hedgeWon = false;
+    };
+    
+    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, HTTPResponse* response) {
+        size_t totalSize = size * nmemb;
+        if (response->decoded_bytes == 0) presize(*response);
+        response->decoded_bytes += totalSize;
+        response->data.append(static_cast<char*>(contents), totalSize);
+        return totalSize;
+    }
+    
+    // Headers are complete once the body starts. Content-Length counts the bytes on
+    // the wire, a lower bound for compressed bodies, which grow from there.
+    static void presize(HTTPResponse& response) {
+        auto it = response.headers.find("content-length");
+        if (it == response.headers.end() || it->second.empty() ||
+            !std::all_of(it->second.begin(), it->second.end(), ::isdigit)) {
+            return;
+        }
+        
+        size_t length = std::stoull(it->second.substr(0, 15));
+        response.data.reserve(std::min(length, ReceiveBufferPool::kMaxCapacity));
+    }
+    
+    static size_t StreamCallback(void* contents, size_t size, size_t nmemb, StreamState* state) {
+        size_t totalSize = size * nmemb;
+        state->response->decoded_bytes += totalSize;
+        
+        // Error pages are drained without reaching the handler
+        long status = 0;
+        curl_easy_getinfo(state->curl, CURLINFO_RESPONSE_CODE, &status);
+        if (status != 200) return totalSize;
+        
+        if (state->cacheWriter) {
+            state->cacheWriter->append(static_cast<char*>(contents), totalSize);
+        }
+        state->delivered += totalSize;
+        if (!(*state->handler)(static_cast<char*>(contents), totalSize)) {
+            state->stopped = true;
+            return 0; // Aborts the transfer with CURLE_WRITE_ERROR
+        }
+        return totalSize;
+    }
+    
+    static size_t HeaderCallback(char* buffer, size_t size, size_t nitems, HTTPResponse* response) {
+        size_t totalSize = size * nitems;
+        std::string line(buffer, totalSize);
+        
+        // Each response in a redirect chain starts with a status line
+        if (line.compare(0, 5, "HTTP/") == 0) {
+            response->headers.clear();
+            return totalSize;
+        }
+        
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) return totalSize;
+        
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        size_t start = line.find_first_not_of(" \t", colon + 1);
+        size_t end = line.find_last_not_of(" \t\r\n");
+        response->headers[name] = (start == std::string::npos || end < start) ? "" : line.substr(start, end - start + 1);
+        return totalSize;
+    }
+    
+    static int CancelCallback(void* cancelled, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        return static_cast<const std::atomic<bool>*>(cancelled)->load() ? 1 : 0;
+    }
+    
+    static void LockCallback(CURL*, curl_lock_data data, curl_lock_access, void* client) {
+        static_cast<HTTPClient*>(client)->shareLocks_[data].lock();
+    }
+    
+    static void UnlockCallback(CURL*, curl_lock_data data, void* client) {
+        static_cast<HTTPClient*>(client)->shareLocks_[data].unlock();
+    }
+
+public:
+    // Handles share DNS results, TLS sessions and open connections, so repeat
+    // requests to the same host skip the lookup and handshakes entirely
+    explicit HTTPClient(const HTTPClientOptions& options = HTTPClientOptions())
+        : share_(curl_share_init()), limiter_(options.rateLimit), retry_(options.retry),
+          metrics_(options.metrics) {
+        if (!share_) {
+            throw std::runtime_error("Failed to initialize CURL share handle");
+        }
+        if (!options.cacheDir.empty()) {
+            cache_ = std::make_unique<ResponseCache>(options.cacheDir);
+        }
+        if (!options.recordPath.empty()) {
+            recorder_ = std::make_unique<TrafficRecorder>(options.recordPath);
+        }
+        if (!options.replayPath.empty()) {
+            replay_ = std::make_shared<const TrafficArchive>(options.replayPath);
+            replayLatency_ = options.replayLatency;
+        }
+        curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, LockCallback);
+        curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, UnlockCallback);
+        curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+        
+        // Slots freed by any transfer, blocking ones included, admit parked requests
+        limiter_.onSlotFreed([this](const std::string& host) {
+            FetchEngine* loop = engine_;
+            if (loop && !closing_) loop->post([this, host] { unpark(host); });
+        });
+    }
+    
+    ~HTTPClient() {
+        closing_ = true;
+        engineOwner_.reset(); // Settles whatever is still in flight or scheduled while everything else exists
+        for (auto& waiting : parked_) {
+            for (const auto& request : waiting.second) abortAsync(request);
+        }
+        parked_.clear();
+        
+        if (recorder_ && !recorder_->close()) {
+            Logger::error("Could not write traffic archive " + recorder_->path());
+        }
+        for (CURL* curl : pool_) {
+            curl_easy_cleanup(curl);
+        }
+        curl_share_cleanup(share_);
+    }
+    
+    HTTPClient(const HTTPClient&) = delete;
+    HTTPClient& operator=(const HTTPClient&) = delete;
+    
+    // Transient failures are retried with backoff; with hedging enabled a request
+    // that outlives the recent p95 latency races a duplicate
+    HTTPResponse get(const std::string& url, int timeout = 30) {
+        if (replay_) return replay(url, nullptr);
+        
+        ResponseCache::Entry validators;
+        bool revalidating = lookupCache(url, validators);
+        const ResponseCache::Entry* conditional = revalidating ? &validators : nullptr;
+        
+        HTTPResponse response = withRetries(url, [&]() {
+            return retry_.options().hedge ? fetchHedged(url, timeout, conditional) : fetch(url, timeout, conditional);
+        }, []() { return true; });
+        
+        if (revalidating && response.status_code == 304) {
+            if (!serveFromCache(url, response)) {
+                return get(url, timeout); // Entry vanished, fetch it unconditionally
+            }
+        } else if (cache_ && response.success) {
+            if (revalidating) cache_->recordRefresh();
+            cache_->store(url, validatorsOf(response), response.data);
+        }
+        record(url, response, response.body());
+        return response;
+    }
+    
+    // Hands the body to `handler` chunk by chunk instead of buffering it in response.data.
+    // Retried only until the handler has seen data, and never hedged.
+    HTTPResponse stream(const std::string& url, const ChunkHandler& handler, int timeout = 30) {
+        if (replay_) return replay(url, &handler);
+        if (!recorder_) return streamLive(url, handler, timeout);
+        
+        // The archive needs the body the handler saw
+        std::string body;
+        HTTPResponse response = streamLive(url, [&](const char* data, size_t size) {
+            body.append(data, size);
+            return handler(data, size);
+        }, timeout);
+        record(url, response, body);
+        return response;
+    }
+    
+    // get() without a thread per request: the transfer runs on the client's event
+    // loop, which takes any number at once, and `done` is called on the loop
+    // thread, so it must not block. Cached, paced, retried and recorded like
+    // get(), but never hedged.
+    void getAsync(const std::string& url, ResponseHandler done, int timeout = 30) {
+        auto request = std::make_shared<AsyncRequest>();
+        request->url = url;
+        request->host = URLUtils::origin(url);
+        request->timeout = timeout;
+        request->done = std::move(done);
+        if (closing_) {
+            abortAsync(request); // Called from a completion while the client shuts down
+            return;
+        }
+        FetchEngine& loop = engine();
+        loop.post([this, request] { startAsync(request); });
+    }
+    
+    std::future<HTTPResponse> getFuture(const std::string& url, int timeout = 30) {
+        auto promise = std::make_shared<std::promise<HTTPResponse>>();
+        std::future<HTTPResponse> future = promise->get_future();
+        getAsync(url, [promise](HTTPResponse response) { promise->set_value(std::move(response)); }, timeout);
+        return future;
+    }
+
+#ifdef LINKEX_COROUTINES
+    // `HTTPResponse response = co_await client.awaitGet(url);` The coroutine
+    // resumes on the event loop thread.
+    struct GetAwaiter {
+        HTTPClient* client;
+        std::string url;
+        int timeout;
+        HTTPResponse response;
+        
+        bool await_ready() const noexcept { return false; }
+        
+        void await_suspend(std::coroutine_handle<> waiting) {
+            client->getAsync(url, [this, waiting](HTTPResponse finished) {
+                response = std::move(finished);
+                waiting.resume();
+            }, timeout);
+        }
+        
+        HTTPResponse await_resume() { return std::move(response); }
+    };
+    
+    GetAwaiter awaitGet(const std::string& url, int timeout = 30) {
+        return GetAwaiter{this, url, timeout, HTTPResponse()};
+    }
+#endif
+    
+    Stats stats() const {
+        Stats s;
+        s.requests = requests_;
+        s.poolHits = poolHits_;
+        s.poolMisses = poolMisses_;
+        s.connectionsReused = connectionsReused_;
+        s.connectionsOpened = connectionsOpened_;
+        s.http2Transfers = http2Transfers_;
+        s.retries = retries_;
+        s.hedges = hedges_;
+        s.hedgeWins = hedgeWins_;
+        s.wireBytes = wireBytes_;
+        s.decodedBytes = decodedBytes_;
+        s.buffersReused = buffers_->reused();
+        s.recorded = recorder_ ? recorder_->size() : 0;
+        s.replayed = replayed_;
+        s.replayMisses = replayMisses_;
+        if (const FetchEngine* loop = engine_) {
+            FetchEngine::Stats e = loop->stats();
+            s.asyncTransfers = e.transfers;
+            s.peakInFlight = e.peakActive;
+        }
+        return s;
+    }
+    
+    void printStats() const {
+        Logger::flush();
+        Stats s = stats();
+        std::cout << "\033[1mHTTP Requests:\033[0m " << s.requests
+                  << " (" << s.http2Transfers << " over HTTP/2)" << std::endl;
+        std::cout << "\033[1mHandle Pool:\033[0m " << s.poolHits << " hits, "
+                  << s.poolMisses << " misses" << std::endl;
+        std::cout << "\033[1mConnections:\033[0m " << s.connectionsReused << " reused, "
+                  << s.connectionsOpened << " opened" << std::endl;
+        std::ostringstream transfer;
+        transfer << std::fixed << std::setprecision(2) << s.wireBytes / 1048576.0 << " MiB on the wire, "
+                 << s.decodedBytes / 1048576.0 << " MiB decoded";
+        if (s.wireBytes > 0 && s.decodedBytes > s.wireBytes) {
+            transfer << " (" << std::setprecision(1) << static_cast<double>(s.decodedBytes) / s.wireBytes << "x)";
+        }
+        std::cout << "\033[1mTransfer:\033[0m " << transfer.str() << ", " << s.buffersReused
+                  << " receive buffers reused" << std::endl;
+        if (cache_) {
+            ResponseCache::Stats c = cache_->stats();
+            std::cout << "\033[1mResponse Cache:\033[0m " << c.hits << " hits (304), "
+                      << c.refreshed << " refreshed, " << c.misses << " misses, " << c.stores << " stored" << std::endl;
+        }
+        if (recorder_) {
+            std::cout << "\033[1mRecorded:\033[0m " << s.recorded << " responses to " << recorder_->path() << std::endl;
+        }
+        if (replay_) {
+            std::cout << "\033[1mReplayed:\033[0m " << s.replayed << " responses, " << s.replayMisses
+                      << " not in the archive" << std::endl;
+        }
+        if (engine_) {
+            std::cout << "\033[1mEvent Loop:\033[0m " << s.asyncTransfers << " transfers on one thread, up to "
+                      << s.peakInFlight << " at once" << std::endl;
+        }
+        std::cout << "\033[1mRetries:\033[0m " << s.retries << " retried, " << s.hedges << " hedged ("
+                  << s.hedgeWins << " won)" << std::endl;
+        RateLimiter::Stats r = limiter_.stats();
+        std::ostringstream waited;
+        waited << std::fixed << std::setprecision(2) << r.waitedSeconds;
+        std::cout << "\033[1mRate Limiter:\033[0m " << r.backoffs << " back-offs, "
+                  << waited.str() << "s waiting for a slot" << std::endl;
+    }
+    
+    const RateLimiter& limiter() const { return limiter_; }
+    
+    const ResponseCache* cache() const { return cache_.get(); }
+
+private:
+    HTTPResponse streamLive(const std::string& url, const ChunkHandler& handler, int timeout) {
+        ResponseCache::Entry validators;
+        bool revalidating = lookupCache(url, validators);
+        std::unique_ptr<ResponseCache::Writer> cacheWriter;
+        if (cache_) {
+            cacheWriter = std::make_unique<ResponseCache::Writer>(cache_.get(), url);
+        }
+        
+        size_t delivered = 0;
+        HTTPResponse response = withRetries(url, [&]() {
+            HTTPResponse attempt;
+            CURL* curl = acquire();
+            if (!curl) {
+                attempt.error_message = "Failed to initialize CURL";
+                return attempt;
+            }
+            
+            StreamState state{&handler, curl, &attempt, cacheWriter.get()};
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamCallback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &state);
+            perform(curl, url, timeout, attempt, revalidating ? &validators : nullptr, &state.stopped);
+            delivered = state.delivered;
+            
+            release(curl);
+            return attempt;
+        }, [&]() { return delivered == 0; });
+        
+        if (revalidating && response.status_code == 304) {
+            if (!serveFromCache(url, response)) {
+                return streamLive(url, handler, timeout);
+            }
+            
+            // Replay the cached body through the handler as if it were arriving
+            response.stopped_early = !deliver(response.body(), handler);
+        } else if (cacheWriter && response.success && !response.stopped_early) {
+            // Only complete bodies are cached; early-stopped streams are discarded
+            if (revalidating) cache_->recordRefresh();
+            cacheWriter->commit(validatorsOf(response));
+        }
+        return response;
+    }
+    
+    // Feeds `body` to the handler in 64 KiB chunks, spread over `seconds` if given.
+    // False if the handler stopped early.
+    static bool deliver(std::string_view body, const ChunkHandler& handler, double seconds = 0.0) {
+        const size_t chunkSize = 64 * 1024;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < body.size(); offset += chunkSize) {
+            if (seconds > 0.0) {
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(seconds * offset / body.size())));
+            }
+            size_t size = std::min(chunkSize, body.size() - offset);
+            if (!handler(body.data() + offset, size)) return false;
+        }
+        return true;
+    }
+    
+    // Serves a recorded response; bodies stay in the archive's mapping. The event
+    // loop passes `wait` = false and delays the completion itself.
+    HTTPResponse replay(const std::string& url, const ChunkHandler* handler, bool wait = true) {
+        HTTPResponse response;
+        ArchivedResponse recorded;
+        ++requests_;
+        if (!replay_->find(url, recorded)) {
+            ++replayMisses_;
+            response.curl_code = CURLE_COULDNT_CONNECT;
+            response.error_message = "Not in the replay archive";
+            return response;
+        }
+        ++replayed_;
+        
+        response.status_code = recorded.status;
+        response.headers = recorded.headerMap();
+        response.first_byte_seconds = recorded.firstByteSeconds;
+        response.total_seconds = recorded.totalSeconds;
+        response.decoded_bytes = recorded.body.size();
+        response.success = recorded.status == 200;
+        if (!response.success) {
+            response.error_message = "Replayed error response (HTTP " + std::to_string(recorded.status) + ")";
+        }
+        decodedBytes_ += recorded.body.size();
+        
+        if (replayLatency_ && wait) {
+            double seconds = handler ? recorded.firstByteSeconds : recorded.totalSeconds;
+            std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        }
+        if (!handler) {
+            response.archive = replay_;
+            response.archived_body = recorded.body;
+            return response;
+        }
+        if (response.success) {
+            double transfer = replayLatency_ ? recorded.totalSeconds - recorded.firstByteSeconds : 0.0;
+            response.stopped_early = !deliver(recorded.body, *handler, transfer);
+        }
+        return response;
+    }
+    
+    // Archives what the caller received: a 304 is recorded as the cached 200
+    void record(const std::string& url, const HTTPResponse& response, std::string_view body) {
+        if (!recorder_ || response.status_code == 0) return;
+        recorder_->record(url, response.from_cache ? 200 : response.status_code, response.headers, body,
+                          response.first_byte_seconds, response.total_seconds, response.stopped_early);
+    }
+    
+    FetchEngine& engine() {
+        std::call_once(engineOnce_, [this] {
+            engineOwner_ = std::make_unique<FetchEngine>();
+            engine_ = engineOwner_.get();
+        });
+        return *engineOwner_;
+    }
+    
+    // The steps of getAsync(), all on the loop thread
+    void startAsync(const std::shared_ptr<AsyncRequest>& request) {
+        if (closing_) {
+            abortAsync(request);
+            return;
+        }
+        if (replay_) {
+            HTTPResponse response = replay(request->url, nullptr, false);
+            auto delay = std::chrono::duration<double>(replayLatency_ ? response.total_seconds : 0.0);
+            engineOwner_->schedule(std::chrono::duration_cast<FetchEngine::Clock::duration>(delay),
+                                   [request, response]() mutable { request->done(std::move(response)); });
+            return;
+        }
+        request->revalidating = lookupCache(request->url, request->validators);
+        request->queued = RateLimiter::Clock::now();
+        admitAsync(request);
+    }
+    
+    void admitAsync(const std::shared_ptr<AsyncRequest>& request) {
+        if (closing_) {
+            abortAsync(request);
+            return;
+        }
+        auto waiting = parked_.find(request->host);
+        if (waiting != parked_.end()) {
+            waiting->second.push_back(request); // Behind the ones already waiting for this host
+            return;
+        }
+        
+        RateLimiter::Clock::time_point retryAt;
+        if (limiter_.tryAcquire(request->host, request->queued, request->permit, retryAt)) {
+            transferAsync(request);
+        } else if (retryAt == RateLimiter::Clock::time_point::max()) {
+            parked_[request->host].push_back(request); // Until a slot of the host frees up
+        } else {
+            engineOwner_->schedule(retryAt - RateLimiter::Clock::now(), [this, request] { admitAsync(request); });
+        }
+    }
+    
+    // Admits waiting requests of `host` in order, as long as its window has room
+    void unpark(const std::string& host) {
+        if (closing_) return; // The destructor fails whatever is parked
+        auto it = parked_.find(host);
+        if (it == parked_.end()) return;
+        auto& waiting = it->second;
+        while (!waiting.empty()) {
+            std::shared_ptr<AsyncRequest> request = waiting.front();
+            RateLimiter::Clock::time_point retryAt;
+            if (limiter_.tryAcquire(host, request->queued, request->permit, retryAt)) {
+                waiting.pop_front();
+                transferAsync(request);
+            } else if (retryAt != RateLimiter::Clock::time_point::max()) {
+                waiting.pop_front();
+                engineOwner_->schedule(retryAt - RateLimiter::Clock::now(), [this, request] { admitAsync(request); });
+            } else {
+                break;
+            }
+        }
+        if (waiting.empty()) parked_.erase(it);
+    }
+    
+    // Settles a request the client will not carry out because it is shutting down
+    static void abortAsync(const std::shared_ptr<AsyncRequest>& request) {
+        HTTPResponse response;
+        response.curl_code = CURLE_ABORTED_BY_CALLBACK;
+        response.error_message = "HTTP client shut down";
+        request->done(std::move(response));
+    }
+    
+    void transferAsync(const std::shared_ptr<AsyncRequest>& request) {
+        HTTPResponse& response = request->response;
+        response = HTTPResponse();
+        response.data = buffers_->acquire();
+        response.pool = buffers_;
+        if (request->cancelled && *request->cancelled) {
+            // Lost its race while waiting for admission
+            limiter_.complete(request->permit, RateLimiter::Outcome::Failed, 0.0);
+            response.curl_code = CURLE_ABORTED_BY_CALLBACK;
+            response.error_message = "Cancelled";
+            finishAsync(request);
+            return;
+        }
+        CURL* curl = acquire();
+        if (!curl) {
+            limiter_.complete(request->permit, RateLimiter::Outcome::Failed, 0.0);
+            response.error_message = "Failed to initialize CURL";
+            finishAsync(request);
+            return;
+        }
+        
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+        if (request->cancelled) {
+            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, CancelCallback);
+            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, const_cast<std::atomic<bool>*>(request->cancelled.get()));
+            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        }
+        request->requestHeaders = configure(curl, request->url, request->timeout, response,
+                                            request->revalidating ? &request->validators : nullptr);
+        engineOwner_->add(curl, [this, request, curl](CURLcode result) {
+            bool cancelled = request->cancelled && *request->cancelled;
+            settle(curl, request->url, request->response, request->permit, result, nullptr, cancelled);
+            curl_slist_free_all(request->requestHeaders);
+            request->requestHeaders = nullptr;
+            release(curl);
+            finishAsync(request);
+        });
+    }
+    
+    void finishAsync(const std::shared_ptr<AsyncRequest>& request) {
+        HTTPResponse& response = request->response;
+        if (closing_ || request->raced) {
+            request->done(std::move(response));
+            return;
+        }
+        if (shouldRetry(response, request->retry)) {
+            auto delay = retryDelay(request->url, request->retry++, response);
+            engineOwner_->schedule(delay, [this, request] {
+                request->queued = RateLimiter::Clock::now();
+                admitAsync(request);
+            });
+            return;
+        }
+        
+        if (request->revalidating && response.status_code == 304) {
+            if (!serveFromCache(request->url, response)) {
+                // Entry vanished, fetch it unconditionally
+                request->revalidating = false;
+                request->retry = 0;
+                admitAsync(request);
+                return;
+            }
+        } else if (cache_ && response.success) {
+            if (request->revalidating) cache_->recordRefresh();
+            cache_->store(request->url, validatorsOf(response), response.data);
+        }
+        record(request->url, response, response.body());
+        request->done(std::move(response));
+    }
+    
+    // One buffered attempt
+    HTTPResponse fetch(const std::string& url, int timeout, const ResponseCache::Entry* validators) {
+        HTTPResponse response;
+        response.data = buffers_->acquire();
+        response.pool = buffers_;
+        CURL* curl = acquire();
+        
+        if (!curl) {
+            response.error_message = "Failed to initialize CURL";
+            return response;
+        }
+        
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+        perform(curl, url, timeout, response, validators);
+        
+        release(curl);
+        return response;
+    }
+    
+    // Both requests of a race run on the event loop while the caller waits; the
+    // first usable response wins and the other transfer is aborted
+    HTTPResponse fetchHedged(const std::string& url, int timeout, const ResponseCache::Entry* validators) {
+        if (latency_.size() < retry_.options().hedgeMinSamples) {
+            return fetch(url, timeout, validators);
+        }
+        auto hedgeAfter = std::chrono::duration<double>(latency_.percentile(0.95));
+        
+        auto race = std::make_shared<HedgeRace>();
+        FetchEngine& loop = engine();
+        
+        // Called with race->mutex held
+        auto launch = [&](bool hedge) {
+            ++race->launched;
+            auto request = std::make_shared<AsyncRequest>();
+            request->url = url;
+            request->host = URLUtils::origin(url);
+            request->timeout = timeout;
+            request->raced = true;
+            request->cancelled = std::shared_ptr<const std::atomic<bool>>(race, &race->cancelled);
+            if (validators) {
+                request->validators = *validators;
+                request->revalidating = true;
+            }
+            request->done = [race, hedge](HTTPResponse response) {
+                {
+                    std::lock_guard<std::mutex> lock(race->mutex);
+                    ++race->done;
+                    bool usable = response.success || response.status_code == 304;
+                    if (!race->winner && (usable || race->done == race->launched)) {
+                        race->winner = std::move(response);
+                        race->hedgeWon = hedge;
+                        race->cancelled = true;
+                    }
+                }
+                race->finished.notify_all();
+            };
+            loop.post([this, request] {
+                request->queued = RateLimiter::Clock::now();
+                admitAsync(request);
+            });
+        };
+        
+        std::unique_lock<std::mutex> lock(race->mutex);
+        launch(false);
+        if (!race->finished.wait_for(lock, hedgeAfter, [&] { return race->winner.has_value(); })) {
+            ++hedges_;
+            launch(true);
+            race->finished.wait(lock, [&] { return race->winner.has_value(); });
+        }
+        if (race->hedgeWon) ++hedgeWins_;
+        return std::move(*race->winner);
+    }
+    
+    // `canRetry` vetoes another attempt, e.g. once a stream handler has seen data
+    template <typename Attempt, typename CanRetry>
+    HTTPResponse withRetries(const std::string& url, Attempt attempt, CanRetry canRetry) {
+        for (size_t retry = 0;; ++retry) {
+            HTTPResponse response = attempt();
+            if (!shouldRetry(response, retry) || !canRetry()) {
+                return response;
+            }
+            
+            std::this_thread::sleep_for(retryDelay(url, retry, response));
+        }
+    }
+    
+    bool shouldRetry(const HTTPResponse& response, size_t retry) const {
+        return !response.success && !response.stopped_early && retry < retry_.options().maxRetries &&
+               RetryPolicy::retryable(response.curl_code, response.status_code);
+    }
+    
+    std::chrono::milliseconds retryDelay(const std::string& url, size_t retry, const HTTPResponse& response) {
+        auto delay = retry_.delay(retry);
+        ++retries_;
+        Logger::warning("Retrying " + url + " in " + std::to_string(delay.count()) + " ms (" +
+                        std::to_string(retry + 1) + "/" + std::to_string(retry_.options().maxRetries) +
+                        "): " + response.error_message);
+        return delay;
+    }
+    
+    void perform(CURL* curl, const std::string& url, int timeout, HTTPResponse& response,
+                 const ResponseCache::Entry* validators = nullptr, const bool* stopped = nullptr) {
+        curl_slist* requestHeaders = configure(curl, url, timeout, response, validators);
+        
+        // Perform request once the host's limiter admits it
+        RateLimiter::Permit permit = limiter_.acquire(URLUtils::origin(url));
+        CURLcode res = curl_easy_perform(curl);
+        curl_slist_free_all(requestHeaders);
+        settle(curl, url, response, permit, res, stopped);
+    }
+    
+    // Sets the options every transfer shares; the returned header list must
+    // outlive the transfer
+    curl_slist* configure(CURL* curl, const std::string& url, int timeout, HTTPResponse& response,
+                          const ResponseCache::Entry* validators) {
+        // Conditional request headers when revalidating a cached response
+        curl_slist* requestHeaders = nullptr;
+        if (validators) {
+            if (!validators->etag.empty()) {
+                requestHeaders = curl_slist_append(requestHeaders, ("If-None-Match: " + validators->etag).c_str());
+            }
+            if (!validators->lastModified.empty()) {
+                requestHeaders = curl_slist_append(requestHeaders, ("If-Modified-Since: " + validators->lastModified).c_str());
+            }
+        }
+        
+        // Configure CURL
+        curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "linkex/2.0 (Advanced Web Scraper)");
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L); // Required when transfers run on worker threads
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, ""); // Every encoding libcurl can decode (gzip, deflate, br, zstd)
+        // The shared connection cache is capped by each handle's MAXCONNECTS (default 5);
+        // with more transfers in flight, finished connections were closed instead of kept
+        curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, 64L);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &response);
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, requestHeaders);
+        
+        return requestHeaders;
+    }
+    
+    // Bookkeeping once a transfer has ended: status, timings, limiter feedback, stats.
+    // A `cancelled` hedge loser only gives back its limiter slot.
+    void settle(CURL* curl, const std::string& url, HTTPResponse& response, const RateLimiter::Permit& permit,
+                CURLcode res, const bool* stopped = nullptr, bool cancelled = false) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response.status_code);
+        
+        if (stopped && *stopped && res == CURLE_WRITE_ERROR) {
+            response.stopped_early = true;
+            res = CURLE_OK;
+        }
+        
+        response.curl_code = res;
+        
+        curl_off_t ttfb = 0;
+        curl_off_t total = 0;
+        curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb);
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+        response.first_byte_seconds = ttfb / 1e6;
+        response.total_seconds = total / 1e6;
+        if (res == CURLE_OK && !response.stopped_early &&
+            (response.status_code == 200 || response.status_code == 304)) {
+            latency_.record(total / 1e6);
+        }
+        bool overloaded = response.status_code == 429 || response.status_code == 503 ||
+                          res == CURLE_OPERATION_TIMEDOUT;
+        limiter_.complete(permit,
+                          overloaded ? RateLimiter::Outcome::Overloaded :
+                          res == CURLE_OK ? RateLimiter::Outcome::Healthy : RateLimiter::Outcome::Failed,
+                          ttfb / 1e6, overloaded ? retryAfter(response) : 0.0);
+        
+        if (cancelled && res == CURLE_ABORTED_BY_CALLBACK) {
+            response.error_message = "Cancelled";
+            return;
+        }
+        if (metrics_) {
+            recordTiming(curl, url, response);
+        }
+        
+        curl_off_t wireBytes = 0;
+        curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wireBytes);
+        wireBytes_ += static_cast<size_t>(wireBytes);
+        decodedBytes_ += response.decoded_bytes;
+        
+        long newConnections = 0;
+        long httpVersion = 0;
+        curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &newConnections);
+        curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &httpVersion);
+        ++requests_;
+        if (res == CURLE_OK) {
+            if (newConnections == 0) {
+                ++connectionsReused_;
+            } else {
+                connectionsOpened_ += static_cast<size_t>(newConnections);
+            }
+            if (httpVersion == CURL_HTTP_VERSION_2_0) {
+                ++http2Transfers_;
+            }
+        }
+        
+        if (res == CURLE_OK && response.status_code == 200) {
+            response.success = true;
+        } else {
+            response.error_message = curl_easy_strerror(res);
+            if (response.status_code != 200) {
+                response.error_message += " (HTTP " + std::to_string(response.status_code) + ")";
+            }
+        }
+    }
+    
+    void recordTiming(CURL* curl, const std::string& url, const HTTPResponse& response) {
+        auto seconds = [curl](CURLINFO info) {
+            curl_off_t micros = 0;
+            curl_easy_getinfo(curl, info, &micros);
+            return micros / 1e6;
+        };
+        
+        RequestTiming timing;
+        timing.url = url;
+        timing.status = response.status_code;
+        timing.nameLookup = seconds(CURLINFO_NAMELOOKUP_TIME_T);
+        timing.connect = seconds(CURLINFO_CONNECT_TIME_T);
+        timing.appConnect = seconds(CURLINFO_APPCONNECT_TIME_T);
+        timing.startTransfer = seconds(CURLINFO_STARTTRANSFER_TIME_T);
+        timing.total = seconds(CURLINFO_TOTAL_TIME_T);
+        curl_off_t bytes = 0;
+        curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+        timing.bytes = static_cast<double>(bytes);
+        timing.decodedBytes = static_cast<double>(response.decoded_bytes);
+        metrics_->addRequest(std::move(timing));
+    }
+    
+    // Retry-After as seconds from now; it may be a delay or an HTTP date
+    static double retryAfter(const HTTPResponse& response) {
+        std::string value = response.header("retry-after");
+        if (value.empty()) return 0.0;
+        
+        if (std::all_of(value.begin(), value.end(), ::isdigit)) {
+            return std::stod(value);
+        }
+        time_t when = curl_getdate(value.c_str(), nullptr);
+        if (when < 0) return 0.0;
+        return std::max(0.0, std::difftime(when, std::time(nullptr)));
+    }
+    
+    bool lookupCache(const std::string& url, ResponseCache::Entry& validators) {
+        if (!cache_) return false;
+        if (cache_->lookup(url, validators)) return true;
+        cache_->recordMiss();
+        return false;
+    }
+    
+    bool serveFromCache(const std::string& url, HTTPResponse& response) {
+        response.cached_body = cache_->openBody(url);
+        if (!response.cached_body) {
+            cache_->remove(url);
+            return false;
+        }
+        cache_->recordHit();
+        response.success = true;
+        response.from_cache = true;
+        response.error_message.clear();
+        return true;
+    }
+    
+    static ResponseCache::Entry validatorsOf(const HTTPResponse& response) {
+        ResponseCache::Entry entry;
+        entry.etag = response.header("etag");
+        entry.lastModified = response.header("last-modified");
+        return entry;
+    }
+    
+    CURL* acquire() {
+        {
+            std::lock_guard<std::mutex> lock(poolMutex_);
+            if (!pool_.empty()) {
+                CURL* curl = pool_.back();
+                pool_.pop_back();
+                ++poolHits_;
+                return curl;
+            }
+        }
+        ++poolMisses_;
+        return curl_easy_init();
+    }
+    
+    // curl_easy_reset keeps live connections and caches, only options are cleared
+    void release(CURL* curl) {
+        curl_easy_reset(curl);
+        std::lock_guard<std::mutex> lock(poolMutex_);
+        pool_.push_back(curl);
+    }
+};
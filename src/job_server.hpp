@@ -0,0 +1,590 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "http_client.hpp"
+#include "logger.hpp"
+#include "manga_scraper.hpp"
+#include "output_sink.hpp"
+#include "string_utils.hpp"
+#include "url_utils.hpp"
+
+// ============================================================================
+// JOB SERVER
+// ============================================================================
+
+// One scrape requested over the API, sent as a flat JSON object:
+// {"url": "...", "format": "jsonl", "unsorted": true, "stream": false, "incremental": false}
+struct ScrapeJob {
+    std::string url;
+    OutputFormat format = OutputFormat::JsonLines;
+    bool unsorted = false;    // Send chapters as they are extracted, in page order
+    bool streaming = false;   // Extract while downloading, as with --stream
+    bool incremental = false;
+    
+    static bool parse(const std::string& json, ScrapeJob& job, std::string& error) {
+        size_t pos = 0;
+        auto fail = [&](const std::string& reason) {
+            error = reason + " at offset " + std::to_string(pos);
+            return false;
+        };
+        
+        skipSpace(json, pos);
+        if (pos >= json.size() || json[pos] != '{') return fail("Expected a JSON object");
+        ++pos;
+        skipSpace(json, pos);
+        
+        bool first = true;
+        while (pos < json.size() && json[pos] != '}') {
+            if (!first) {
+                if (json[pos] != ',') return fail("Expected ',' or '}'");
+                ++pos;
+                skipSpace(json, pos);
+            }
+            first = false;
+            
+            std::string key;
+            if (!parseString(json, pos, key)) return fail("Expected a field name");
+            skipSpace(json, pos);
+            if (pos >= json.size() || json[pos] != ':') return fail("Expected ':'");
+            ++pos;
+            skipSpace(json, pos);
+            
+            if (key == "url") {
+                if (!parseString(json, pos, job.url)) return fail("\"url\" must be a string");
+            } else if (key == "format") {
+                std::string format;
+                if (!parseString(json, pos, format) || !ChapterSink::parseFormat(format, job.format)) {
+                    return fail("\"format\" must be one of txt, jsonl, tsv, urls");
+                }
+            } else if (key == "unsorted" || key == "stream" || key == "incremental") {
+                bool& flag = key == "unsorted" ? job.unsorted : key == "stream" ? job.streaming : job.incremental;
+                if (!parseBool(json, pos, flag)) return fail("\"" + key + "\" must be true or false");
+            } else {
+                return fail("Unknown field \"" + key + "\"");
+            }
+            skipSpace(json, pos);
+        }
+        if (pos >= json.size()) return fail("Unterminated object");
+        ++pos;
+        skipSpace(json, pos);
+        if (pos != json.size()) return fail("Unexpected data after the object");
+        
+        if (!URLUtils::isValid(job.url)) {
+            error = job.url.empty() ? "Missing \"url\"" : "Invalid URL: " + job.url;
+            return false;
+        }
+        if (job.unsorted && !ChapterSink::canStream(job.format)) {
+            error = "\"unsorted\" needs format jsonl, tsv or urls";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static void skipSpace(const std::string& json, size_t& pos) {
+        while (pos < json.size() && std::isspace(static_cast<unsigned char>(json[pos]))) ++pos;
+    }
+    
+    static bool parseBool(const std::string& json, size_t& pos, bool& value) {
+        for (bool candidate : {true, false}) {
+            const char* word = candidate ? "true" : "false";
+            size_t length = std::strlen(word);
+            if (json.compare(pos, length, word) == 0) {
+                value = candidate;
+                pos += length;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    static bool parseString(const std::string& json, size_t& pos, std::string& out) {
+        if (pos >= json.size() || json[pos] != '"') return false;
+        out.clear();
+        for (++pos; pos < json.size(); ++pos) {
+            char c = json[pos];
+            if (c == '"') {
+                ++pos;
+                return true;
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (++pos >= json.size()) return false;
+            switch (json[pos]) {
+                case '"': case '\\': case '/': out += json[pos]; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned long code = 0;
+                    if (!parseHex4(json, pos, code)) return false;
+                    // A high surrogate followed by a low one encodes one code point
+                    if (code >= 0xD800 && code < 0xDC00 && json.compare(pos + 1, 2, "\\u") == 0) {
+                        size_t next = pos + 2;
+                        unsigned long low = 0;
+                        if (parseHex4(json, next, low) && low >= 0xDC00 && low < 0xE000) {
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            pos = next;
+                        }
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return false;
+    }
+    
+    // `pos` is on the 'u'; left on the last hex digit
+    static bool parseHex4(const std::string& json, size_t& pos, unsigned long& code) {
+        if (pos + 4 >= json.size()) return false;
+        std::string digits = json.substr(pos + 1, 4);
+        if (!std::all_of(digits.begin(), digits.end(), ::isxdigit)) return false;
+        code = std::stoul(digits, nullptr, 16);
+        pos += 4;
+        return true;
+    }
+    
+    static void appendUtf8(std::string& out, unsigned long code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+};
+
+// Long-running scrape service. Speaks HTTP/1.1 on a localhost port or a Unix
+// socket, one request per connection:
+//   POST /scrape   ScrapeJob JSON in, the chapter list out (chunked, so a job
+//                  that fails after chapters were sent ends without the final chunk)
+//   GET  /stats    Jobs served and HTTP client counters as JSON
+//   GET  /health   "ok"
+// Jobs run on a fixed pool of workers sharing one HTTPClient, so connections,
+// DNS/TLS state, the response cache and the rate limiter stay warm, and the
+// compiled selectors are reused by every job.
+class JobServer {
+private:
+    struct Request {
+        std::string method;
+        std::string path;
+        std::string body;
+    };
+    
+    static constexpr size_t kMaxHeaderBytes = 16 * 1024;
+    static constexpr size_t kMaxBodyBytes = 64 * 1024;
+    
+    std::string address_;
+    size_t workers_;
+    ScrapeOptions defaults_;
+    HTTPClient client_;
+    int listenFd_ = -1;
+    std::string socketPath_; // Unix socket to remove on shutdown
+    
+    std::mutex queueMutex_;
+    std::condition_variable queued_;
+    std::deque<int> connections_;
+    bool stopping_ = false;
+    
+    std::atomic<size_t> nextJob_{0};
+    std::atomic<size_t> succeeded_{0};
+    std::atomic<size_t> failed_{0};
+    std::atomic<size_t> active_{0};
+    std::chrono::steady_clock::time_point started_ = std::chrono::steady_clock::now();
+
+public:
+    // `address` is a port or host:port (TCP), or a path containing '/' (Unix socket)
+    JobServer(std::string address, size_t workers, const ScrapeOptions& defaults,
+              const HTTPClientOptions& clientOptions)
+        : address_(std::move(address)), workers_(std::max<size_t>(1, workers)), defaults_(defaults),
+          client_(clientOptions) {
+        defaults_.showProgress = false;
+        defaults_.toStdout = false;
+        if (!defaults_.selectors) {
+            defaults_.selectors = PageSelectors::defaults();
+        }
+    }
+    
+    ~JobServer() {
+        if (listenFd_ >= 0) ::close(listenFd_);
+        if (!socketPath_.empty()) ::unlink(socketPath_.c_str());
+    }
+    
+    JobServer(const JobServer&) = delete;
+    JobServer& operator=(const JobServer&) = delete;
+    
+    bool listen() {
+        std::string error;
+        if (address_.find('/') != std::string::npos ? listenUnix(error) : listenTcp(error)) {
+            Logger::success("Serving scrape jobs on " + address_ + " with " + std::to_string(workers_) + " workers");
+            return true;
+        }
+        Logger::error("Could not listen on " + address_ + ": " + error);
+        if (listenFd_ >= 0) {
+            ::close(listenFd_);
+            listenFd_ = -1;
+        }
+        return false;
+    }
+    
+    // Accepts connections until `stop` is set, then finishes the queued ones
+    void run(const std::atomic<bool>& stop) {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < workers_; ++i) {
+            threads.emplace_back([this] { work(); });
+        }
+        
+        pollfd listening{listenFd_, POLLIN, 0};
+        while (!stop) {
+            if (::poll(&listening, 1, 250) <= 0) continue;
+            int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) continue;
+            
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            connections_.push_back(fd);
+            queued_.notify_one();
+        }
+        
+        Logger::info("Shutting down, waiting for " + std::to_string(active_) + " running jobs");
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            stopping_ = true;
+        }
+        queued_.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        Logger::success("Served " + std::to_string(succeeded_ + failed_) + " jobs (" +
+                        std::to_string(failed_) + " failed)");
+    }
+
+private:
+    bool listenTcp(std::string& error) {
+        std::string host = "127.0.0.1";
+        std::string port = address_;
+        size_t colon = address_.rfind(':');
+        if (colon != std::string::npos) {
+            host = address_.substr(0, colon);
+            port = address_.substr(colon + 1);
+            if (host == "localhost") host = "127.0.0.1";
+        }
+        
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        if (port.empty() || port.size() > 5 || !std::all_of(port.begin(), port.end(), ::isdigit) ||
+            std::stoul(port) > 65535 || ::inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+            error = "expected PORT, HOST:PORT or a socket path";
+            return false;
+        }
+        address.sin_port = htons(static_cast<uint16_t>(std::stoul(port)));
+        
+        listenFd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if (listenFd_ < 0 ||
+            ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+            ::bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd_, 128) != 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+    
+    bool listenUnix(std::string& error) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (address_.size() >= sizeof(address.sun_path)) {
+            error = "socket path too long";
+            return false;
+        }
+        std::strcpy(address.sun_path, address_.c_str());
+        
+        // A socket left behind by an earlier run refuses connections; replace it
+        ::unlink(address_.c_str());
+        listenFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd_ < 0 ||
+            ::bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd_, 128) != 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        socketPath_ = address_;
+        return true;
+    }
+    
+    void work() {
+        for (;;) {
+            int fd;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex_);
+                queued_.wait(lock, [this] { return stopping_ || !connections_.empty(); });
+                if (connections_.empty()) return;
+                fd = connections_.front();
+                connections_.pop_front();
+            }
+            serve(fd);
+            ::close(fd);
+        }
+    }
+    
+    void serve(int fd) {
+        timeval timeout{10, 0}; // Idle clients must not hold a worker
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        
+        Request request;
+        std::string error;
+        if (!readRequest(fd, request, error)) {
+            respond(fd, 400, "application/json", errorJson(error));
+            return;
+        }
+        
+        if (request.path == "/scrape") {
+            if (request.method != "POST") {
+                respond(fd, 405, "application/json", errorJson("Use POST"));
+                return;
+            }
+            runJob(fd, request.body);
+        } else if (request.path == "/stats" || request.path == "/health") {
+            if (request.method != "GET") {
+                respond(fd, 405, "application/json", errorJson("Use GET"));
+                return;
+            }
+            if (request.path == "/health") {
+                respond(fd, 200, "text/plain; charset=utf-8", "ok\n");
+            } else {
+                respond(fd, 200, "application/json", statsJson());
+            }
+        } else {
+            respond(fd, 404, "application/json", errorJson("Unknown path " + request.path));
+        }
+    }
+    
+    void runJob(int fd, const std::string& body) {
+        ScrapeJob job;
+        std::string error;
+        if (!ScrapeJob::parse(body, job, error)) {
+            respond(fd, 400, "application/json", errorJson(error));
+            return;
+        }
+        
+        size_t id = ++nextJob_;
+        ++active_;
+        Logger::setContext("job " + std::to_string(id));
+        Logger::info("Scraping " + job.url);
+        auto start = std::chrono::steady_clock::now();
+        
+        ScrapeOptions options = defaults_;
+        options.format = job.format;
+        options.unsorted = job.unsorted;
+        options.streaming = job.streaming;
+        options.incremental = job.incremental;
+        options.output = std::make_shared<OutputFile>();
+        
+        bool sent = false; // Status line is out; failures can only cut the body short
+        bool ok = false;
+        try {
+            MangaScraper scraper(job.url, client_, options);
+            if (job.unsorted) {
+                sent = sendHead(fd, 200, contentType(job.format), id);
+                options.output->attach(fd, true);
+                ok = sent && scraper.scrape() && scraper.saveToFile();
+            } else if (scraper.scrape()) {
+                sent = sendHead(fd, 200, contentType(job.format), id);
+                options.output->attach(fd, true);
+                ok = sent && scraper.saveToFile();
+            }
+            error = scraper.lastError();
+            if (ok) ok = options.output->finish();
+            
+            if (ok) {
+                Logger::success("Sent " + std::to_string(scraper.chapterLinks().size()) + " chapters for " +
+                                job.url + " in " + elapsedSince(start));
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        
+        if (!ok) {
+            if (error.empty()) error = "Could not send the response";
+            Logger::error("Job failed: " + error);
+            if (!sent) respond(fd, 502, "application/json", errorJson(error), id);
+        }
+        (ok ? succeeded_ : failed_)++;
+        --active_;
+        Logger::setContext("");
+    }
+    
+    static bool readRequest(int fd, Request& request, std::string& error) {
+        std::string data;
+        char chunk[4096];
+        size_t end;
+        while ((end = data.find("\r\n\r\n")) == std::string::npos) {
+            if (data.size() > kMaxHeaderBytes) {
+                error = "Request header too large";
+                return false;
+            }
+            ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                error = "Incomplete request";
+                return false;
+            }
+            data.append(chunk, static_cast<size_t>(received));
+        }
+        
+        std::istringstream head(data.substr(0, end));
+        std::string line;
+        std::getline(head, line);
+        std::istringstream requestLine(line);
+        requestLine >> request.method >> request.path;
+        request.path = request.path.substr(0, request.path.find('?'));
+        if (request.method.empty() || request.path.empty()) {
+            error = "Malformed request line";
+            return false;
+        }
+        
+        size_t length = 0;
+        bool expectContinue = false;
+        while (std::getline(head, line)) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::string name = StringUtils::toLower(line.substr(0, colon));
+            std::string value = StringUtils::trim(line.substr(colon + 1));
+            if (name == "content-length") {
+                length = std::all_of(value.begin(), value.end(), ::isdigit) && value.size() < 10
+                    ? std::stoul(value) : kMaxBodyBytes + 1;
+            } else if (name == "expect") {
+                expectContinue = StringUtils::toLower(value) == "100-continue";
+            }
+        }
+        if (length > kMaxBodyBytes) {
+            error = "Request body too large";
+            return false;
+        }
+        
+        request.body = data.substr(end + 4);
+        if (expectContinue && request.body.size() < length) {
+            static const char kContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+            ::send(fd, kContinue, sizeof(kContinue) - 1, MSG_NOSIGNAL);
+        }
+        while (request.body.size() < length) {
+            ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                error = "Incomplete request body";
+                return false;
+            }
+            request.body.append(chunk, static_cast<size_t>(received));
+        }
+        request.body.resize(length);
+        return true;
+    }
+    
+    // Status line and headers of a chunked response
+    static bool sendHead(int fd, int status, const std::string& type, size_t job) {
+        std::string head = statusLine(status) + "Content-Type: " + type +
+                           "\r\nTransfer-Encoding: chunked\r\nConnection: close\r\nX-Linkex-Job: " +
+                           std::to_string(job) + "\r\n\r\n";
+        return sendAll(fd, head);
+    }
+    
+    static void respond(int fd, int status, const std::string& type, const std::string& body, size_t job = 0) {
+        std::string response = statusLine(status) + "Content-Type: " + type + "\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\nConnection: close\r\n";
+        if (job > 0) response += "X-Linkex-Job: " + std::to_string(job) + "\r\n";
+        response += "\r\n" + body;
+        sendAll(fd, response);
+    }
+    
+    static bool sendAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+    
+    static std::string statusLine(int status) {
+        const char* reason = "OK";
+        switch (status) {
+            case 400: reason = "Bad Request"; break;
+            case 404: reason = "Not Found"; break;
+            case 405: reason = "Method Not Allowed"; break;
+            case 502: reason = "Bad Gateway"; break;
+        }
+        return "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+    }
+    
+    static const char* contentType(OutputFormat format) {
+        switch (format) {
+            case OutputFormat::JsonLines: return "application/x-ndjson";
+            case OutputFormat::Tsv:       return "text/tab-separated-values; charset=utf-8";
+            default:                      return "text/plain; charset=utf-8";
+        }
+    }
+    
+    static std::string errorJson(const std::string& message) {
+        return "{\"error\":" + StringUtils::quoteJson(message) + "}\n";
+    }
+    
+    std::string statsJson() const {
+        HTTPClient::Stats http = client_.stats();
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1);
+        out << "{\"uptime_seconds\":"
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count()
+            << ",\"jobs\":{\"succeeded\":" << succeeded_ << ",\"failed\":" << failed_ << ",\"active\":" << active_
+            << "},\"http\":{\"requests\":" << http.requests << ",\"connections_reused\":" << http.connectionsReused
+            << ",\"connections_opened\":" << http.connectionsOpened << ",\"retries\":" << http.retries
+            << ",\"wire_bytes\":" << http.wireBytes << ",\"decoded_bytes\":" << http.decodedBytes << "}";
+        if (const ResponseCache* cache = client_.cache()) {
+            ResponseCache::Stats c = cache->stats();
+            out << ",\"cache\":{\"hits\":" << c.hits << ",\"refreshed\":" << c.refreshed << ",\"misses\":" << c.misses << ",\"stores\":" << c.stores << "}";
+        }
+        out << "}\n";
+        return out.str();
+    }
+    
+    static std::string elapsedSince(std::chrono::steady_clock::time_point start) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2)
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s";
+        return out.str();
+    }
+};
@@ -0,0 +1,419 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "string_utils.hpp"
+
+// ============================================================================
+// UTILITY CLASSES AND FUNCTIONS
+// ============================================================================
+
+class ProgressBar;
+
+// Messages are queued without locking and written by one background thread,
+// which batches whatever has accumulated into a single write. The same thread
+// draws the progress line, at most kFrameRate times a second, and clears it
+// before writing messages so the two never interleave.
+class Logger {
+public:
+    enum Level { INFO, WARNING, ERROR, SUCCESS };
+    enum class Format { Text, Json };
+    
+    struct Options {
+        Level minimum = INFO; // SUCCESS ranks with INFO
+        Format format = Format::Text;
+        bool color = true;    // ANSI colors and the live progress line, for terminals
+    };
+    
+    static constexpr int kFrameRate = 10;
+    
+    static void configure(const Options& options) {
+        Writer& w = writer();
+        w.minimum = severity(options.minimum);
+        w.json = options.format == Format::Json;
+        w.color = options.color;
+    }
+    
+    static bool colorEnabled() { return writer().color; }
+    
+    // "info", "warn" or "error"
+    static bool parseLevel(const std::string& name, Level& level) {
+        if (name == "info") level = INFO;
+        else if (name == "warn" || name == "warning") level = WARNING;
+        else if (name == "error") level = ERROR;
+        else return false;
+        return true;
+    }
+    
+    static void log(Level level, const std::string& message) {
+        Writer& w = writer();
+        if (severity(level) < w.minimum) return;
+        w.push(new Record{level, context(), message, std::chrono::system_clock::now()});
+    }
+    
+    // Tag every message logged from the calling thread (used to tell batch jobs apart)
+    static void setContext(const std::string& tag) {
+        context() = tag.empty() ? "" : "[" + tag + "] ";
+    }
+    
+    // Tag of the calling thread, for handing on to worker threads it starts
+    static std::string getContext() {
+        const std::string& ctx = context();
+        return ctx.empty() ? "" : ctx.substr(1, ctx.size() - 3);
+    }
+    
+    static void info(const std::string& msg) { log(INFO, msg); }
+    static void warning(const std::string& msg) { log(WARNING, msg); }
+    static void error(const std::string& msg) { log(ERROR, msg); }
+    static void success(const std::string& msg) { log(SUCCESS, msg); }
+    
+    // Waits until everything logged so far is written; call before printing to std::cout directly
+    static void flush() { writer().flush(); }
+
+private:
+    friend class ProgressBar;
+    
+    struct Record {
+        Level level;
+        std::string context;
+        std::string message;
+        std::chrono::system_clock::time_point time;
+        bool raw = false; // Written as is (a finished progress bar)
+        std::atomic<Record*> next{nullptr};
+        
+        Record(Level level, std::string context, std::string message, std::chrono::system_clock::time_point time)
+            : level(level), context(std::move(context)), message(std::move(message)), time(time) {}
+    };
+    
+    // Multi-producer, single-consumer queue (Vyukov): push() is one atomic
+    // exchange, so logging threads never wait on each other or on the writer
+    class Writer {
+    public:
+        std::atomic<int> minimum{0};
+        std::atomic<bool> json{false};
+        std::atomic<bool> color{true};
+
+    private:
+        std::atomic<Record*> head_;
+        Record* tail_;
+        Record stub_{INFO, "", "", {}};
+        std::atomic<size_t> pushed_{0};
+        size_t written_ = 0; // Guarded by mutex_
+        
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable drained_;
+        std::atomic<bool> running_{true};
+        std::thread thread_;
+        
+        std::mutex barsMutex_;
+        std::vector<const ProgressBar*> bars_;
+        bool statusShown_ = false;
+        std::chrono::steady_clock::time_point lastFrame_;
+
+    public:
+        Writer() : head_(&stub_), tail_(&stub_) {
+            thread_ = std::thread([this] { run(); });
+        }
+        
+        // Runs at exit: whatever is still queued gets written
+        ~Writer() {
+            running_ = false;
+            wake_.notify_one();
+            thread_.join();
+        }
+        
+        void push(Record* record) {
+            ++pushed_;
+            enqueue(record);
+            wake_.notify_one();
+        }
+        
+        void flush() {
+            size_t target = pushed_;
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.notify_one();
+            drained_.wait_for(lock, std::chrono::seconds(5), [&] { return written_ >= target || !running_; });
+        }
+        
+        void addBar(const ProgressBar* bar) {
+            std::lock_guard<std::mutex> lock(barsMutex_);
+            bars_.push_back(bar);
+        }
+        
+        void removeBar(const ProgressBar* bar) {
+            std::lock_guard<std::mutex> lock(barsMutex_);
+            for (auto it = bars_.begin(); it != bars_.end(); ++it) {
+                if (*it == bar) {
+                    bars_.erase(it);
+                    break;
+                }
+            }
+        }
+
+    private:
+        void enqueue(Record* record) {
+            record->next.store(nullptr, std::memory_order_relaxed);
+            Record* previous = head_.exchange(record, std::memory_order_acq_rel);
+            previous->next.store(record, std::memory_order_release);
+        }
+        
+        // Null when empty, or when a producer is between its two steps in enqueue()
+        Record* dequeue() {
+            Record* tail = tail_;
+            Record* next = tail->next.load(std::memory_order_acquire);
+            if (tail == &stub_) {
+                if (!next) return nullptr;
+                tail_ = tail = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next) {
+                tail_ = next;
+                return tail;
+            }
+            if (tail != head_.load(std::memory_order_acquire)) return nullptr;
+            enqueue(&stub_);
+            next = tail->next.load(std::memory_order_acquire);
+            if (!next) return nullptr;
+            tail_ = next;
+            return tail;
+        }
+        
+        void run() {
+            const auto frame = std::chrono::milliseconds(1000 / kFrameRate);
+            for (;;) {
+                bool running = running_;
+                std::string out;
+                size_t count = 0;
+                bool progress = color && !json;
+                
+                for (Record* record = dequeue(); record; record = dequeue()) {
+                    if (count++ == 0 && statusShown_) {
+                        out += "\r\033[K";
+                        statusShown_ = false;
+                    }
+                    format(*record, out);
+                    delete record;
+                }
+                
+                auto now = std::chrono::steady_clock::now();
+                if (progress && now - lastFrame_ >= frame) {
+                    std::string status = renderBars();
+                    if (!status.empty() || statusShown_) {
+                        out += "\r\033[K" + status;
+                        statusShown_ = !status.empty();
+                        lastFrame_ = now;
+                    }
+                }
+                
+                if (!out.empty()) {
+                    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+                    std::cout.flush();
+                }
+                
+                std::unique_lock<std::mutex> lock(mutex_);
+                written_ += count;
+                if (written_ >= pushed_) drained_.notify_all();
+                if (!running) break;
+                wake_.wait_for(lock, frame, [&] { return pushed_ > written_ || !running_; });
+            }
+            
+            if (statusShown_) {
+                std::cout << "\r\033[K" << std::flush;
+            }
+            drained_.notify_all();
+        }
+        
+        void format(const Record& record, std::string& out) const {
+            if (record.raw) {
+                if (color && !json) out += record.message + "\n";
+                return;
+            }
+            if (json) {
+                formatJson(record, out);
+                return;
+            }
+            
+            const char* prefix = "[INFO]";
+            const char* code = "\033[36m"; // Cyan
+            switch (record.level) {
+                case INFO:    break;
+                case WARNING: prefix = "[WARN]"; code = "\033[33m"; break;    // Yellow
+                case ERROR:   prefix = "[ERROR]"; code = "\033[31m"; break;   // Red
+                case SUCCESS: prefix = "[SUCCESS]"; code = "\033[32m"; break; // Green
+            }
+            if (color) {
+                out += code;
+                out += prefix;
+                out += "\033[0m ";
+            } else {
+                out += prefix;
+                out += ' ';
+            }
+            out += record.context;
+            out += record.message;
+            out += '\n';
+        }
+        
+        // {"time":"2026-01-02T03:04:05.678Z","level":"info","context":"…","message":"…"}
+        static void formatJson(const Record& record, std::string& out) {
+            static const char* const names[] = {"info", "warn", "error", "success"};
+            auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                record.time.time_since_epoch()).count();
+            std::time_t seconds = static_cast<std::time_t>(millis / 1000);
+            std::tm utc{};
+            gmtime_r(&seconds, &utc);
+            char time[64];
+            std::snprintf(time, sizeof(time), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", utc.tm_year + 1900,
+                          utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec,
+                          static_cast<int>(millis % 1000));
+            
+            std::string context = record.context.size() > 3
+                ? record.context.substr(1, record.context.size() - 3) : "";
+            out += "{\"time\":\"";
+            out += time;
+            out += "\",\"level\":\"";
+            out += names[record.level];
+            out += "\",\"context\":";
+            out += StringUtils::quoteJson(context);
+            out += ",\"message\":";
+            out += StringUtils::quoteJson(record.message);
+            out += "}\n";
+        }
+        
+        std::string renderBars();
+    };
+    
+    static Writer& writer() {
+        static Writer w;
+        return w;
+    }
+    
+    static int severity(Level level) {
+        return level == SUCCESS ? INFO : level;
+    }
+    
+    static std::string& context() {
+        thread_local std::string ctx;
+        return ctx;
+    }
+};
+
+// Progress of one task. update() only stores the count; the logger's writer
+// thread draws every live bar as one status line, summed when several tasks
+// (concurrent jobs, crawler workers) are running, at a capped frame rate.
+// Nothing is drawn unless colors are on, i.e. on a terminal.
+class ProgressBar {
+private:
+    size_t total_;
+    std::atomic<size_t> current_{0};
+    size_t bar_width_;
+    std::string description_;
+    std::atomic<bool> finished_{false};
+
+public:
+    ProgressBar(size_t total, const std::string& description = "Progress", size_t bar_width = 50)
+        : total_(total), bar_width_(bar_width), description_(description) {
+        Logger::writer().addBar(this);
+    }
+    
+    ~ProgressBar() {
+        Logger::writer().removeBar(this);
+    }
+    
+    ProgressBar(const ProgressBar&) = delete;
+    ProgressBar& operator=(const ProgressBar&) = delete;
+    
+    void update(size_t current) {
+        current_ = current;
+        // The finished bar stays on screen, ordered among the log messages
+        if (current >= total_ && !finished_.exchange(true)) {
+            Logger::Record* record = new Logger::Record(Logger::INFO, "", render(description_, total_, total_, bar_width_),
+                                                        std::chrono::system_clock::now());
+            record->raw = true;
+            Logger::writer().push(record);
+        }
+    }
+    
+    void increment() {
+        update(current_ + 1);
+    }
+    
+    // One escape sequence per run of cells rather than per cell
+    static std::string render(const std::string& description, size_t current, size_t total, size_t width) {
+        double progress = total > 0 ? static_cast<double>(current) / total : 1.0;
+        size_t filled = std::min(width, static_cast<size_t>(progress * width));
+        std::string line = "\033[36m" + description + "\033[0m [\033[32m";
+        for (size_t i = 0; i < filled; ++i) line += "█";
+        line += "\033[90m";
+        for (size_t i = filled; i < width; ++i) line += "░";
+        line += "\033[0m] " + std::to_string(current) + "/" + std::to_string(total) + " (" +
+                std::to_string(static_cast<int>(progress * 100)) + "%)";
+        return line;
+    }
+
+private:
+    friend class Logger;
+};
+
+inline std::string Logger::Writer::renderBars() {
+    std::lock_guard<std::mutex> lock(barsMutex_);
+    size_t current = 0;
+    size_t total = 0;
+    size_t live = 0;
+    const ProgressBar* first = nullptr;
+    for (const ProgressBar* bar : bars_) {
+        if (bar->finished_) continue;
+        current += bar->current_;
+        total += bar->total_;
+        if (!first) first = bar;
+        ++live;
+    }
+    if (!first) return "";
+    std::string description = first->description_;
+    if (live > 1) description += " (" + std::to_string(live) + " tasks)";
+    return ProgressBar::render(description, current, total, first->bar_width_);
+}
+
+// Drops ANSI escape sequences on their way through, for std::cout when it is
+// not a terminal
+class AnsiStripBuffer : public std::streambuf {
+private:
+    std::streambuf* target_;
+    int state_ = 0; // 0 = text, 1 = after ESC, 2 = inside a CSI sequence
+
+public:
+    explicit AnsiStripBuffer(std::streambuf* target) : target_(target) {}
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+        char c = traits_type::to_char_type(ch);
+        if (state_ == 0) {
+            if (c == '\033') {
+                state_ = 1;
+                return ch;
+            }
+            return target_->sputc(c);
+        }
+        if (state_ == 1) {
+            state_ = c == '[' ? 2 : 0;
+            return ch;
+        }
+        if (c >= '@' && c <= '~') state_ = 0; // Final byte of the sequence
+        return ch;
+    }
+    
+    int sync() override { return target_->pubsync(); }
+};
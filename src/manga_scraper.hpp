@@ -0,0 +1,822 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "chapter_crawler.hpp"
+#include "chapter_index.hpp"
+#include "http_client.hpp"
+#include "html_parser.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "output_sink.hpp"
+#include "stream_extractor.hpp"
+#include "string_utils.hpp"
+#include "url_utils.hpp"
+
+// ============================================================================
+// MAIN SCRAPER CLASS
+// ============================================================================
+
+struct ScrapeOptions {
+    bool showProgress = true;   // Interactive progress bar (disabled for batch jobs)
+    std::string outputDir;      // Directory for output files, empty = current directory
+    bool streaming = false;     // Extract links while the page downloads instead of parsing a full DOM
+    std::shared_ptr<const PageSelectors> selectors; // Null = PageSelectors::defaults()
+    bool incremental = false;   // Diff against the series' chapter index and save only the changes
+    size_t knownStreakToStop = 3; // Incremental streaming stops after this many known chapters in a row, 0 = never
+    bool crawlPages = false;    // Fetch every chapter page and write per-chapter image manifests
+    size_t crawlJobs = 8;       // Concurrent chapter page fetches per series
+    std::shared_ptr<const CSSSelector> imageSelector; // Null = every <img>
+    std::shared_ptr<Metrics> metrics; // Per-phase wall-clock timings, null = off
+    OutputFormat format = OutputFormat::Text;
+    bool toStdout = false;      // Write chapters to stdout instead of a file
+    bool unsorted = false;      // Emit chapters in page order as they are extracted (not for Text)
+    std::shared_ptr<OutputFile> output; // Write chapters here instead of a file, e.g. a server connection
+};
+
+class MangaScraper {
+private:
+    std::string baseUrl_;
+    std::vector<std::string> chapterLinks_;
+    std::string mangaTitle_;
+    std::string lastError_;
+    ScrapeOptions options_;
+    HTTPClient& client_;
+    ChapterIndex index_;
+    ChapterIndex::Delta delta_;
+    size_t knownStreak_ = 0;
+    bool stopAtKnown_ = false;  // The page lists chapters newest-first, so a known streak can end it
+    bool reachedKnown_ = false; // Extraction stopped at already-known chapters
+    size_t pagesCrawled_ = 0;
+    size_t pagesFailed_ = 0;
+    size_t imagesFound_ = 0;
+    size_t emitted_ = 0;
+    std::unordered_multimap<size_t, size_t> chapterHashes_; // Hash of each chapter URL -> its index in chapterLinks_
+    size_t duplicates_ = 0;
+    std::optional<HTTPResponse> page_; // Fetched, waiting for extract()
+    std::unique_ptr<ChapterSink> emitter_; // Unsorted mode, opened at the first chapter
+    std::string emitPath_;
+    std::string emitTitle_;
+
+public:
+    MangaScraper(const std::string& url, HTTPClient& client, const ScrapeOptions& options = ScrapeOptions())
+        : baseUrl_(url), options_(options), client_(client) {
+        if (!options_.selectors) {
+            options_.selectors = PageSelectors::defaults();
+        }
+        if (!URLUtils::isValid(url)) {
+            throw std::invalid_argument("Invalid URL provided");
+        }
+    }
+    
+    const std::string& url() const { return baseUrl_; }
+    const std::string& title() const { return mangaTitle_; }
+    const std::vector<std::string>& chapterLinks() const { return chapterLinks_; }
+    const std::string& lastError() const { return lastError_; }
+    const ChapterIndex::Delta& delta() const { return delta_; }
+    const ChapterIndex& index() const { return index_; } // As loaded before this run
+    size_t pagesCrawled() const { return pagesCrawled_; }
+    size_t pagesFailed() const { return pagesFailed_; }
+    size_t imagesFound() const { return imagesFound_; }
+    
+    // Chapter URL -> its number in the main output file. After an early stop
+    // chapterLinks_ holds only the newest chapters, so sorted output is numbered
+    // against the index plus the new chapters; unsorted output keeps page positions.
+    std::unordered_map<std::string, size_t> chapterNumbers() const {
+        std::vector<std::string> all = options_.unsorted ? chapterLinks_ : allChapters();
+        std::unordered_map<std::string, size_t> numbers;
+        numbers.reserve(all.size());
+        for (size_t i = 0; i < all.size(); ++i) {
+            numbers.emplace(all[i], i + 1);
+        }
+        return numbers;
+    }
+    
+    // "-" when writing to stdout or options.output
+    std::string outputPath() const {
+        if (options_.toStdout || options_.output) return "-";
+        if (!emitPath_.empty()) return emitPath_;
+        return pathFor(mangaTitle_);
+    }
+    
+    // Directory holding one image manifest per chapter
+    std::string pagesDir() const {
+        return inOutputDir(StringUtils::createSafeFilename(mangaTitle_) + "_pages");
+    }
+    
+    // Keyed by the URL rather than the title, which is unknown until the page is
+    // read: the slug for people, a hash of the whole URL so series with the same
+    // slug on different hosts or paths keep separate indexes
+    std::string indexPath() const {
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016llx",
+                      static_cast<unsigned long long>(StringUtils::stableHash(URLUtils::normalize(baseUrl_))));
+        return inOutputDir(StringUtils::createSafeFilename(urlSlug()) + "-" + hash + ".index");
+    }
+    
+    bool scrape() {
+        return fetch() && extract() && finish();
+    }
+    
+    // The stages of scrape(), split so a pipeline can run them on different
+    // threads: fetch() is network-bound (in streaming mode it extracts too),
+    // extract() parses and resolves, finish() sorts and diffs.
+    bool fetch() {
+        return guarded([&] {
+            begin();
+            if (options_.streaming) {
+                StreamResult result = scrapeStreaming();
+                if (result == StreamResult::Failed) return false;
+                if (result == StreamResult::Extracted) return true;
+                Logger::warning("No chapter list found while streaming, falling back to full parse");
+                chapterLinks_.clear();
+                chapterHashes_.clear();
+                mangaTitle_.clear();
+            }
+            return fetchDocument();
+        });
+    }
+    
+    // fetch() on the client's event loop, so many scrapes can download at once
+    // without a thread each. `done` gets the result, usually on the loop thread.
+    // Streaming extracts as it downloads, so it runs fetch() on this thread.
+    void fetchAsync(std::function<void(bool)> done) {
+        if (options_.streaming) {
+            done(fetch());
+            return;
+        }
+        if (!guarded([&] { begin(); return true; })) {
+            done(false);
+            return;
+        }
+        Logger::info("Fetching webpage...");
+        fetchPage(std::move(done), Logger::getContext());
+    }
+    
+    bool extract() {
+        return guarded([&] { return !page_ || extractDocument(); });
+    }
+    
+    bool finish() {
+        return guarded([&] {
+            if (duplicates_ > 0) {
+                Logger::info("Dropped " + std::to_string(duplicates_) + " duplicate chapter links");
+            }
+            chapterHashes_.clear(); // Indexes go stale once the list is sorted
+            
+            // Sort chapters naturally; unsorted output keeps page order throughout,
+            // so manifest numbers match the emitted ones
+            if (options_.unsorted) {
+                Logger::info("Emitted " + std::to_string(emitted_) + " chapters in page order");
+            } else {
+                Logger::info("Sorting chapters naturally...");
+                Metrics::Timer timer(options_.metrics.get(), "sort");
+                StringUtils::sortNaturally(chapterLinks_);
+            }
+            
+            if (mangaTitle_.empty() && index_.loaded()) {
+                mangaTitle_ = index_.title();
+            }
+            
+            if (options_.incremental) {
+                delta_ = index_.diff(chapterLinks_, !reachedKnown_);
+                Logger::info(std::to_string(delta_.added.size()) + " new, " +
+                             std::to_string(delta_.removed.size()) + " removed since last run" +
+                             (reachedKnown_ ? " (stopped at known chapters, removals not checked)" : ""));
+            }
+            
+            if (mangaTitle_.empty()) {
+                Logger::warning("Could not extract manga title, using default");
+                mangaTitle_ = "unknown_manga";
+            } else {
+                Logger::success("Found manga: " + mangaTitle_);
+            }
+            return true;
+        });
+    }
+    
+    bool saveToFile() {
+        Metrics::Timer timer(options_.metrics.get(), "save");
+        if (chapterLinks_.empty()) {
+            lastError_ = "No chapter links to save";
+            Logger::error(lastError_);
+            return false;
+        }
+        
+        if (options_.unsorted) {
+            return finishEmitting();
+        }
+        if (options_.incremental) {
+            return saveDelta();
+        }
+        
+        std::string filename = outputPath();
+        Logger::info(filename == "-" ? "Writing to " + describe(filename) : "Saving to file: " + filename);
+        
+        if (!writeRecords(filename, chapterLinks_)) {
+            return false;
+        }
+        
+        Logger::success("Successfully saved " + std::to_string(chapterLinks_.size()) + 
+                       " chapter links to " + describe(filename));
+        return true;
+    }
+    
+    // Incremental runs whose caller reports the delta itself: brings the index
+    // up to date without writing a delta file
+    bool saveIndex() {
+        return guarded([&] { return updateIndex(); });
+    }
+    
+    // Fetches the chapter pages (only new chapters in incremental mode) and writes
+    // <pagesDir>/<chapter number>.txt listing each page's image URLs
+    bool crawlPages() {
+        Metrics::Timer timer(options_.metrics.get(), "crawl");
+        const std::vector<std::string>& chapters = options_.incremental ? delta_.added : chapterLinks_;
+        if (chapters.empty()) {
+            Logger::info("No chapter pages to crawl");
+            return true;
+        }
+        
+        std::string dir = pagesDir();
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if (ec) {
+            lastError_ = "Could not create directory " + dir + ": " + ec.message();
+            Logger::error(lastError_);
+            return false;
+        }
+        
+        Logger::info("Crawling " + std::to_string(chapters.size()) + " chapter pages with " +
+                     std::to_string(std::min(options_.crawlJobs, chapters.size())) + " workers...");
+        auto start = std::chrono::steady_clock::now();
+        
+        ChapterCrawler crawler(client_, options_.crawlJobs, options_.imageSelector, options_.showProgress);
+        std::vector<ChapterPages> results = crawler.crawl(chapters);
+        
+        // Manifests are numbered like the chapters in the main output file
+        std::unordered_map<std::string, size_t> positions = chapterNumbers();
+        
+        std::string timestamp = getCurrentTimestamp();
+        pagesCrawled_ = pagesFailed_ = imagesFound_ = 0;
+        for (const auto& pages : results) {
+            if (!pages.success) {
+                ++pagesFailed_;
+                Logger::warning("Failed to crawl " + pages.url + ": " + pages.error);
+                continue;
+            }
+            
+            size_t position = positions.at(pages.url);
+            std::string path = (std::filesystem::path(dir) /
+                                ChapterCrawler::manifestName(position, positions.size())).string();
+            if (!ChapterCrawler::writeManifest(path, pages, position, timestamp)) {
+                ++pagesFailed_;
+                Logger::warning("Could not write manifest " + path);
+                continue;
+            }
+            ++pagesCrawled_;
+            imagesFound_ += pages.images.size();
+        }
+        
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::ostringstream elapsed;
+        elapsed << std::fixed << std::setprecision(2) << seconds;
+        Logger::success("Crawled " + std::to_string(pagesCrawled_) + "/" + std::to_string(results.size()) +
+                        " chapter pages (" + std::to_string(imagesFound_) + " images, " +
+                        std::to_string(crawler.steals()) + " stolen tasks) in " + elapsed.str() + "s into " + dir);
+        return true;
+    }
+    
+    void printSummary() const {
+        Logger::flush();
+        std::cout << "\n" << std::string(60, '=') << std::endl;
+        std::cout << "\033[1;36m SCRAPING SUMMARY \033[0m" << std::endl;
+        std::cout << std::string(60, '=') << std::endl;
+        std::cout << "\033[1mManga Title:\033[0m " << mangaTitle_ << std::endl;
+        std::cout << "\033[1mSource URL:\033[0m " << baseUrl_ << std::endl;
+        std::cout << "\033[1mChapters Found:\033[0m " << chapterLinks_.size() << std::endl;
+        if (options_.incremental) {
+            std::cout << "\033[1mNew Chapters:\033[0m " << delta_.added.size() << std::endl;
+            std::cout << "\033[1mRemoved Chapters:\033[0m " << delta_.removed.size() << std::endl;
+        }
+        std::cout << "\033[1mFilename:\033[0m " << describe(outputPath()) << std::endl;
+        if (options_.crawlPages) {
+            std::cout << "\033[1mChapter Pages:\033[0m " << pagesCrawled_ << " crawled, " << pagesFailed_
+                      << " failed, " << imagesFound_ << " images in " << pagesDir() << std::endl;
+        }
+        if (options_.metrics) {
+            std::ostringstream phases;
+            phases << std::fixed << std::setprecision(1);
+            for (const auto& [name, phase] : options_.metrics->phases()) {
+                phases << (phases.tellp() > 0 ? ", " : "") << name << " " << phase.total * 1000.0 << " ms";
+            }
+            std::cout << "\033[1mPhase Timings:\033[0m " << phases.str() << std::endl;
+            std::cout << "\033[1mPeak Memory:\033[0m " << Metrics::peakRssBytes() / (1024 * 1024) << " MiB" << std::endl;
+        }
+        client_.printStats();
+        std::cout << std::string(60, '=') << std::endl;
+    }
+    
+    static std::string getCurrentTimestamp() {
+        auto now = std::chrono::system_clock::now();
+        auto time_t = std::chrono::system_clock::to_time_t(now);
+        
+        // localtime_r: saveToFile runs concurrently in batch mode
+        std::tm local{};
+        localtime_r(&time_t, &local);
+        
+        std::stringstream ss;
+        ss << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
+        return ss.str();
+    }
+
+private:
+    enum class StreamResult { Extracted, NotFound, Failed };
+    
+    template <typename Stage>
+    bool guarded(Stage stage) {
+        try {
+            return stage();
+        } catch (const std::exception& e) {
+            lastError_ = "Scraping failed: " + std::string(e.what());
+            Logger::error(lastError_);
+            return false;
+        }
+    }
+    
+    void begin() {
+        Logger::info("Starting scrape for: " + baseUrl_);
+        
+        if (options_.incremental) {
+            loadIndex();
+        }
+    }
+    
+    // Downloads the whole page for extractDocument()
+    bool fetchDocument() {
+        Logger::info("Fetching webpage...");
+        Metrics::Timer fetchTimer(options_.metrics.get(), "fetch");
+        HTTPResponse response = client_.get(baseUrl_);
+        fetchTimer.stop();
+        return acceptPage(std::move(response));
+    }
+
+#ifdef LINKEX_COROUTINES
+    DetachedTask fetchPage(std::function<void(bool)> done, std::string context) {
+        Metrics::Timer fetchTimer(options_.metrics.get(), "fetch");
+        HTTPResponse response = co_await client_.awaitGet(baseUrl_);
+        fetchTimer.stop();
+        
+        Logger::setContext(context);
+        bool accepted = guarded([&] { return acceptPage(std::move(response)); });
+        Logger::setContext("");
+        done(accepted);
+    }
+#else
+    void fetchPage(std::function<void(bool)> done, std::string context) {
+        auto fetchTimer = std::make_shared<Metrics::Timer>(options_.metrics.get(), "fetch");
+        client_.getAsync(baseUrl_, [this, done, context, fetchTimer](HTTPResponse response) {
+            fetchTimer->stop();
+            
+            Logger::setContext(context);
+            bool accepted = guarded([&] { return acceptPage(std::move(response)); });
+            Logger::setContext("");
+            done(accepted);
+        });
+    }
+#endif
+    
+    // Keeps a downloaded page for extractDocument()
+    bool acceptPage(HTTPResponse response) {
+        if (!response.success) {
+            lastError_ = "Failed to fetch webpage: " + response.error_message;
+            Logger::error(lastError_);
+            return false;
+        }
+        
+        Logger::success("Webpage fetched successfully (" + std::to_string(response.body().length()) + " bytes" +
+                        (response.from_cache ? ", not modified, served from cache)" : ")"));
+        page_ = std::move(response);
+        return true;
+    }
+    
+    // Parses the fetched page with Gumbo; the page goes back to the buffer pool afterwards
+    bool extractDocument() {
+        std::optional<HTTPResponse> page = std::move(page_);
+        page_.reset();
+        
+        // Only the selectors' containers are parsed when the page allows it
+        Logger::info("Parsing HTML content...");
+        const PageSelectors& selectors = *options_.selectors;
+        Metrics::Timer parseTimer(options_.metrics.get(), "parse");
+        std::optional<HTMLParser> parser;
+        parser.emplace(page->body(), selectors.scopeIds);
+        parseTimer.stop();
+        
+        // Extract chapter links and title in a single traversal
+        Logger::info("Extracting chapter links...");
+        Metrics::Timer extractTimer(options_.metrics.get(), "extract");
+        std::vector<const CSSSelector*> query;
+        for (const auto& selector : selectors.chapterLinks) {
+            query.push_back(&selector);
+        }
+        query.push_back(&selectors.title);
+        static const CSSSelector baseSelector("base[href]");
+        query.push_back(&baseSelector);
+        auto matches = parser->select(query);
+        
+        // Take the first chapter selector that matched, in configured order
+        std::vector<HTMLElement> chapterElements;
+        auto takeChapters = [&] {
+            for (size_t i = 0; i < selectors.chapterLinks.size(); ++i) {
+                if (!matches[i].empty()) {
+                    chapterElements = std::move(matches[i]);
+                    break;
+                }
+            }
+        };
+        takeChapters();
+        
+        // A container that parses differently out of context: retry with the whole page
+        if (chapterElements.empty() && parser->scoped()) {
+            parser.emplace(page->body());
+            matches = parser->select(query);
+            takeChapters();
+        }
+        
+        if (chapterElements.empty()) {
+            lastError_ = "No chapter links found with standard selectors";
+            Logger::warning(lastError_);
+            return false;
+        }
+        
+        // Extract manga title
+        Logger::info("Extracting manga title...");
+        const auto& titleElements = matches[matches.size() - 2];
+        
+        if (!titleElements.empty()) {
+            mangaTitle_ = StringUtils::trim(titleElements[0].getText());
+        }
+        
+        // Process chapter links with progress bar
+        std::unique_ptr<ProgressBar> progress;
+        if (options_.showProgress) {
+            progress = std::make_unique<ProgressBar>(chapterElements.size(), "Processing chapters");
+        }
+        
+        // Links resolve against the first <base href>, itself relative to the page
+        const auto& baseElements = matches.back();
+        std::string base = baseElements.empty()
+            ? baseUrl_ : URLUtils::resolve(baseUrl_, StringUtils::trimmed(baseElements[0].attribute("href")));
+        
+        // Attribute values are views into the tree; only the resolved URLs are allocated
+        chapterLinks_.reserve(chapterLinks_.size() + chapterElements.size());
+        for (size_t i = 0; i < chapterElements.size(); ++i) {
+            const auto& element = chapterElements[i];
+            
+            std::string_view href = element.attribute("href");
+            if (href.empty()) {
+                href = element.attribute("src");
+            }
+            
+            href = StringUtils::trimmed(href);
+            if (!href.empty()) {
+                std::string url = URLUtils::normalize(URLUtils::resolve(base, href));
+                if (rememberChapter(url)) {
+                    chapterLinks_.push_back(std::move(url));
+                    emitChapter(chapterLinks_.back(), mangaTitle_);
+                }
+            }
+            
+            if (progress) {
+                progress->update(i + 1);
+            }
+        }
+        
+        return true;
+    }
+    
+    // Extracts links while the page downloads and stops once #chapters-list closes
+    StreamResult scrapeStreaming() {
+        Logger::info("Streaming webpage and extracting chapter links...");
+        Metrics::Timer timer(options_.metrics.get(), "stream");
+        
+        auto start = std::chrono::steady_clock::now();
+        size_t received = 0;
+        
+        // The tokenizer tracks containers by id, taken from the configured selectors
+        const PageSelectors& selectors = *options_.selectors;
+        std::string chaptersId = selectors.chapterLinks.empty() ? "" : selectors.chapterLinks.front().leadingId();
+        if (chaptersId.empty()) {
+            Logger::warning("Streaming needs a chapter selector that starts with an #id");
+            return StreamResult::NotFound;
+        }
+        
+        std::string base; // Set at the first link; a <base href> sits in the <head> before it
+        ChapterStreamExtractor extractor(chaptersId, selectors.title.leadingId(), [&](const std::string& href) {
+            if (chapterLinks_.empty()) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+                Logger::info("First chapter link after " + std::to_string(elapsed.count()) + " ms (" +
+                             std::to_string(received) + " bytes received)");
+            }
+            if (base.empty()) {
+                base = URLUtils::resolve(baseUrl_, extractor.baseHref());
+            }
+            addChapterLink(URLUtils::normalize(URLUtils::resolve(base, StringUtils::trimmed(href))), extractor.title());
+        });
+        
+        HTTPResponse response = client_.stream(baseUrl_, [&](const char* data, size_t size) {
+            received += size;
+            return extractor.feed(data, size) && !reachedKnown_;
+        });
+        
+        if (!response.success) {
+            lastError_ = "Failed to fetch webpage: " + response.error_message;
+            Logger::error(lastError_);
+            return StreamResult::Failed;
+        }
+        
+        if (chapterLinks_.empty()) {
+            return StreamResult::NotFound;
+        }
+        
+        Logger::success("Extracted " + std::to_string(chapterLinks_.size()) + " chapter links from " +
+                        std::to_string(received) + " bytes" +
+                        (reachedKnown_ ? " (stopped reading at known chapters)" :
+                         response.stopped_early ? " (stopped reading after the chapter list)" : ""));
+        mangaTitle_ = extractor.title();
+        return StreamResult::Extracted;
+    }
+    
+    std::string inOutputDir(const std::string& filename) const {
+        if (options_.outputDir.empty()) return filename;
+        return (std::filesystem::path(options_.outputDir) / filename).string();
+    }
+    
+    // Streaming only: in a newest-first list, a run of known chapters means the
+    // rest is known too, so the download can end there. Returns false at that point.
+    bool addChapterLink(std::string url, const std::string& title) {
+        if (reachedKnown_) return false;
+        if (!rememberChapter(url)) return true;
+        
+        if (chapterLinks_.empty()) {
+            stopAtKnown_ = options_.knownStreakToStop > 0 && index_.loaded() && startsWithNewest(url);
+        }
+        if (stopAtKnown_) {
+            knownStreak_ = index_.contains(url) ? knownStreak_ + 1 : 0;
+            if (knownStreak_ >= options_.knownStreakToStop) {
+                reachedKnown_ = true;
+            }
+        }
+        chapterLinks_.push_back(std::move(url));
+        emitChapter(chapterLinks_.back(), title);
+        return !reachedKnown_;
+    }
+    
+    // True when the page's first chapter is not older than anything in the index
+    bool startsWithNewest(const std::string& first) const {
+        const std::vector<std::string>& known = index_.chapters();
+        if (known.empty()) return false;
+        const std::string& newest = *std::max_element(known.begin(), known.end(), StringUtils::naturalSort);
+        if (!StringUtils::naturalSort(first, newest)) return true;
+        Logger::info("Chapters are not listed newest-first, reading the whole list");
+        return false;
+    }
+    
+    // False for a URL already in chapterLinks_ (desktop and mobile menus list each chapter twice)
+    bool rememberChapter(const std::string& url) {
+        size_t hash = std::hash<std::string>{}(url);
+        auto range = chapterHashes_.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (chapterLinks_[it->second] == url) {
+                ++duplicates_;
+                return false;
+            }
+        }
+        chapterHashes_.emplace(hash, chapterLinks_.size());
+        return true;
+    }
+    
+    std::string urlSlug() const {
+        std::string slug = baseUrl_;
+        while (!slug.empty() && slug.back() == '/') slug.pop_back();
+        return slug.substr(slug.find_last_of('/') + 1);
+    }
+    
+    std::string pathFor(const std::string& title) const {
+        std::string suffix = std::string(options_.incremental ? ".delta" : "") + ChapterSink::extension(options_.format);
+        return inOutputDir(StringUtils::createSafeFilename(title) + suffix);
+    }
+    
+    std::string describe(const std::string& path) const {
+        if (path != "-") return path;
+        return options_.output ? "the connection" : "stdout";
+    }
+    
+    bool openSink(ChapterSink& sink, const std::string& filename, bool streaming) {
+        if (!options_.output) return sink.open(filename, streaming);
+        sink.attach(options_.output, streaming);
+        return true;
+    }
+    
+    // Unsorted mode: writes the chapter out right away (only new ones when
+    // incremental). Numbers are positions on the page.
+    void emitChapter(const std::string& url, const std::string& title) {
+        if (!options_.unsorted || (options_.incremental && index_.contains(url))) return;
+        
+        if (!emitter_) {
+            openEmitter(title);
+        } else if (title != emitTitle_) {
+            emitter_->setSeries(title, baseUrl_, getCurrentTimestamp());
+            emitTitle_ = title;
+        }
+        emitter_->add(chapterLinks_.size(), url);
+        ++emitted_;
+    }
+    
+    // Named after the title if the page has shown it by now, otherwise the URL
+    void openEmitter(const std::string& title) {
+        emitPath_ = outputPath() == "-" ? "-" : pathFor(title.empty() ? urlSlug() : title);
+        emitter_ = ChapterSink::create(options_.format);
+        if (!openSink(*emitter_, emitPath_, true)) {
+            Logger::error("Could not create file " + emitPath_ + ": " + emitter_->error());
+        }
+        emitter_->setSeries(title, baseUrl_, getCurrentTimestamp());
+        emitTitle_ = title;
+    }
+    
+    // Unsorted mode: everything is written already, so only close the output and
+    // bring the index up to date
+    bool finishEmitting() {
+        if (!emitter_) {
+            openEmitter(mangaTitle_); // Nothing new, but leave the (empty) output behind
+        }
+        std::string filename = outputPath();
+        if (!emitter_->close()) {
+            lastError_ = "Could not write " + describe(filename) + ": " + emitter_->error();
+            Logger::error(lastError_);
+            return false;
+        }
+        Logger::success("Emitted " + std::to_string(emitted_) + " chapter links to " + describe(filename));
+        return !options_.incremental || updateIndex();
+    }
+    
+    // Renders `chapters` through the configured sink into one buffer and writes
+    // it at once. Empty `numbers` = position in `chapters`.
+    bool writeRecords(const std::string& filename, const std::vector<std::string>& chapters,
+                      const std::vector<size_t>& numbers = {}) {
+        std::unique_ptr<ChapterSink> sink = ChapterSink::create(options_.format);
+        if (!openSink(*sink, filename, false)) {
+            lastError_ = "Could not create file: " + filename;
+            Logger::error(lastError_);
+            return false;
+        }
+        
+        sink->setSeries(mangaTitle_, baseUrl_, getCurrentTimestamp());
+        sink->reserve(chapters);
+        sink->header(chapters.size());
+        for (size_t i = 0; i < chapters.size(); ++i) {
+            sink->add(numbers.empty() ? i + 1 : numbers[i], chapters[i]);
+        }
+        
+        if (!sink->close()) {
+            lastError_ = "Could not write " + describe(filename) + ": " + sink->error();
+            Logger::error(lastError_);
+            return false;
+        }
+        return true;
+    }
+    
+    void loadIndex() {
+        index_ = ChapterIndex(indexPath());
+        ChapterIndex::LoadResult result = index_.load(baseUrl_);
+        if (result == ChapterIndex::LoadResult::Missing) {
+            // Indexes written before they were keyed by the whole URL are picked up
+            // once and saved under the new name; one of another series is simply not ours
+            index_.load(baseUrl_, inOutputDir(StringUtils::createSafeFilename(urlSlug()) + ".index"));
+        }
+        
+        if (index_.loaded()) {
+            Logger::info("Loaded chapter index with " + std::to_string(index_.size()) + " known chapters");
+        } else if (result == ChapterIndex::LoadResult::OtherSource) {
+            Logger::warning("Chapter index " + index_.path() + " belongs to another series and will be replaced; "
+                            "every chapter counts as new");
+        } else {
+            Logger::info("No chapter index yet, every chapter counts as new");
+        }
+    }
+    
+    // Writes the added/removed chapters and updates the index
+    bool saveDelta() {
+        std::string filename = outputPath();
+        Logger::info(filename == "-" ? std::string("Writing changes to stdout") : "Saving changes to file: " + filename);
+        
+        if (options_.format == OutputFormat::Text) {
+            if (!writeDeltaText(filename)) return false;
+        } else {
+            // Other formats list only the additions, numbered like the full list
+            std::unordered_map<std::string, size_t> positions = chapterNumbers();
+            std::vector<size_t> numbers;
+            numbers.reserve(delta_.added.size());
+            for (const auto& url : delta_.added) {
+                numbers.push_back(positions[url]);
+            }
+            if (!writeRecords(filename, delta_.added, numbers)) return false;
+        }
+        
+        if (!updateIndex()) return false;
+        Logger::success("Saved " + std::to_string(delta_.added.size()) + " new chapter links to " + describe(filename));
+        return true;
+    }
+    
+    bool writeDeltaText(const std::string& filename) {
+        // Removed chapters are comments so consumers reading bare URLs see only additions
+        std::string text;
+        text.reserve(512 + (delta_.added.size() + delta_.removed.size()) * 128);
+        text += "# Manga Chapter Links (changes since last run)\n";
+        text += "# Title: " + mangaTitle_ + "\n";
+        text += "# Source: " + baseUrl_ + "\n";
+        text += "# Previously Known: " + std::to_string(index_.size()) + "\n";
+        text += "# New Chapters: " + std::to_string(delta_.added.size()) + "\n";
+        text += "# Removed Chapters: " + (reachedKnown_ ? std::string("not checked") : std::to_string(delta_.removed.size())) + "\n";
+        text += "# Generated: " + getCurrentTimestamp() + "\n";
+        text += "# ==========================================\n\n";
+        
+        for (const auto& url : delta_.added) {
+            text += url;
+            text += '\n';
+        }
+        if (!delta_.removed.empty()) {
+            text += "\n# Removed\n";
+            for (const auto& url : delta_.removed) {
+                text += "# - " + url + "\n";
+            }
+        }
+        
+        std::shared_ptr<OutputFile> file = options_.output;
+        if (!file) {
+            file = std::make_shared<OutputFile>();
+            if (!file->open(filename)) {
+                lastError_ = "Could not create file: " + filename;
+                Logger::error(lastError_);
+                return false;
+            }
+        }
+        if (!file->write(text) || (file != options_.output && !file->close())) {
+            lastError_ = "Could not write " + describe(filename) + ": " + file->error();
+            Logger::error(lastError_);
+            return false;
+        }
+        return true;
+    }
+    
+    // Every chapter of the series once. A truncated scan only adds to what the
+    // index already knew.
+    std::vector<std::string> allChapters() const {
+        std::vector<std::string> all;
+        if (reachedKnown_) {
+            all = index_.chapters();
+            all.insert(all.end(), delta_.added.begin(), delta_.added.end());
+            StringUtils::sortNaturally(all);
+        } else {
+            std::unordered_set<std::string> seen;
+            for (const auto& url : chapterLinks_) {
+                if (seen.insert(url).second) all.push_back(url);
+            }
+        }
+        return all;
+    }
+    
+    bool updateIndex() {
+        if (index_.loaded() && delta_.added.empty() && delta_.removed.empty()) {
+            Logger::success("No changes since last run, index left untouched");
+            return true;
+        }
+        
+        if (!index_.save(baseUrl_, mangaTitle_, allChapters(), getCurrentTimestamp())) {
+            lastError_ = "Could not write chapter index: " + index_.path();
+            Logger::error(lastError_);
+            return false;
+        }
+        
+        Logger::info("Updated " + index_.path());
+        return true;
+    }
+};
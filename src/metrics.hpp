@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "string_utils.hpp"
+
+// ============================================================================
+// METRICS
+// ============================================================================
+
+// Timings of one HTTP transfer as reported by curl. Times are seconds since the
+// transfer started, so each includes the ones before it.
+struct RequestTiming {
+    std::string url;
+    long status = 0;
+    double nameLookup = 0.0;
+    double connect = 0.0;
+    double appConnect = 0.0;    // TLS handshake done, 0 for plain HTTP
+    double startTransfer = 0.0; // First byte received
+    double total = 0.0;
+    double bytes = 0.0;         // Body bytes on the wire, compressed if the server compressed them
+    double decodedBytes = 0.0;  // Body bytes after content decoding
+};
+
+// Per-request network timings and per-phase wall-clock times for a run,
+// exported as JSON or in the Prometheus textfile-collector format
+class Metrics {
+public:
+    struct Phase {
+        size_t count = 0;
+        double total = 0.0;
+        double max = 0.0;
+    };
+    
+    // Adds the time until destruction to a phase
+    class Timer {
+    private:
+        Metrics* metrics_;
+        std::string phase_;
+        std::chrono::steady_clock::time_point start_;
+
+    public:
+        Timer(Metrics* metrics, std::string phase)
+            : metrics_(metrics), phase_(std::move(phase)), start_(std::chrono::steady_clock::now()) {}
+        
+        ~Timer() { stop(); }
+        
+        // Records now instead of at destruction
+        void stop() {
+            if (metrics_) {
+                metrics_->addPhase(phase_, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+                metrics_ = nullptr;
+            }
+        }
+        
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+    };
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<RequestTiming> requests_;
+    std::map<std::string, Phase> phases_;
+    std::chrono::steady_clock::time_point started_ = std::chrono::steady_clock::now();
+
+public:
+    void addRequest(RequestTiming timing) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requests_.push_back(std::move(timing));
+    }
+    
+    void addPhase(const std::string& name, double seconds) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Phase& phase = phases_[name];
+        ++phase.count;
+        phase.total += seconds;
+        phase.max = std::max(phase.max, seconds);
+    }
+    
+    std::map<std::string, Phase> phases() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return phases_;
+    }
+    
+    // Peak resident set size of the process so far
+    static size_t peakRssBytes() {
+        struct rusage usage {};
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+        return static_cast<size_t>(usage.ru_maxrss) * 1024; // Kilobytes on Linux
+    }
+    
+    bool writeJson(const std::string& path) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ostringstream out;
+        out << std::setprecision(9);
+        
+        out << "{\n";
+        out << "  \"generated\": " << std::time(nullptr) << ",\n";
+        out << "  \"wall_seconds\": " << elapsed() << ",\n";
+        out << "  \"peak_rss_bytes\": " << peakRssBytes() << ",\n";
+        
+        out << "  \"phases\": {";
+        const char* separator = "\n";
+        for (const auto& [name, phase] : phases_) {
+            out << separator << "    " << quote(name) << ": {\"count\": " << phase.count
+                << ", \"total_seconds\": " << phase.total << ", \"max_seconds\": " << phase.max << "}";
+            separator = ",\n";
+        }
+        out << "\n  },\n";
+        
+        Phase totals[kTimingCount];
+        double bytes = 0.0;
+        double decoded = 0.0;
+        summarize(totals, bytes, decoded);
+        out << "  \"http\": {\n";
+        out << "    \"requests\": " << requests_.size() << ",\n";
+        out << "    \"bytes\": " << bytes << ",\n";
+        out << "    \"decoded_bytes\": " << decoded;
+        for (size_t i = 0; i < kTimingCount; ++i) {
+            out << ",\n    " << quote(std::string(kTimingNames[i]) + "_seconds") << ": {\"total\": "
+                << totals[i].total << ", \"max\": " << totals[i].max << "}";
+        }
+        out << "\n  },\n";
+        
+        out << "  \"requests\": [";
+        separator = "\n";
+        for (const auto& request : requests_) {
+            out << separator << "    {\"url\": " << quote(request.url) << ", \"status\": " << request.status;
+            for (size_t i = 0; i < kTimingCount; ++i) {
+                out << ", " << quote(kTimingNames[i]) << ": " << timingOf(request, i);
+            }
+            out << ", \"bytes\": " << request.bytes << ", \"decoded_bytes\": " << request.decodedBytes << "}";
+            separator = ",\n";
+        }
+        out << "\n  ]\n}\n";
+        
+        return writeAtomically(path, out.str());
+    }
+    
+    // node_exporter reads *.prom files from its textfile directory; the file is
+    // replaced atomically so a collection never sees half of it
+    bool writePrometheus(const std::string& path) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ostringstream out;
+        out << std::setprecision(9);
+        
+        out << "# HELP linkex_phase_seconds_total Wall-clock seconds spent in each scrape phase.\n";
+        out << "# TYPE linkex_phase_seconds_total counter\n";
+        for (const auto& [name, phase] : phases_) {
+            out << "linkex_phase_seconds_total{phase=" << quote(name) << "} " << phase.total << "\n";
+        }
+        out << "# HELP linkex_phase_runs_total Times each scrape phase ran.\n";
+        out << "# TYPE linkex_phase_runs_total counter\n";
+        for (const auto& [name, phase] : phases_) {
+            out << "linkex_phase_runs_total{phase=" << quote(name) << "} " << phase.count << "\n";
+        }
+        out << "# HELP linkex_phase_max_seconds Longest single run of each scrape phase.\n";
+        out << "# TYPE linkex_phase_max_seconds gauge\n";
+        for (const auto& [name, phase] : phases_) {
+            out << "linkex_phase_max_seconds{phase=" << quote(name) << "} " << phase.max << "\n";
+        }
+        
+        Phase totals[kTimingCount];
+        double bytes = 0.0;
+        double decoded = 0.0;
+        summarize(totals, bytes, decoded);
+        out << "# HELP linkex_http_requests_total HTTP transfers performed.\n";
+        out << "# TYPE linkex_http_requests_total counter\n";
+        out << "linkex_http_requests_total " << requests_.size() << "\n";
+        out << "# HELP linkex_http_download_bytes_total Response body bytes received on the wire.\n";
+        out << "# TYPE linkex_http_download_bytes_total counter\n";
+        out << "linkex_http_download_bytes_total " << bytes << "\n";
+        out << "# HELP linkex_http_decoded_bytes_total Response body bytes after content decoding.\n";
+        out << "# TYPE linkex_http_decoded_bytes_total counter\n";
+        out << "linkex_http_decoded_bytes_total " << decoded << "\n";
+        out << "# HELP linkex_http_timing_seconds_total Sum over transfers of curl's cumulative timings (namelookup <= connect <= appconnect <= starttransfer <= total).\n";
+        out << "# TYPE linkex_http_timing_seconds_total counter\n";
+        for (size_t i = 0; i < kTimingCount; ++i) {
+            out << "linkex_http_timing_seconds_total{timing=\"" << kTimingNames[i] << "\"} " << totals[i].total << "\n";
+        }
+        out << "# HELP linkex_http_timing_max_seconds Slowest transfer for each curl timing.\n";
+        out << "# TYPE linkex_http_timing_max_seconds gauge\n";
+        for (size_t i = 0; i < kTimingCount; ++i) {
+            out << "linkex_http_timing_max_seconds{timing=\"" << kTimingNames[i] << "\"} " << totals[i].max << "\n";
+        }
+        
+        out << "# HELP linkex_peak_rss_bytes Peak resident set size of the run.\n";
+        out << "# TYPE linkex_peak_rss_bytes gauge\n";
+        out << "linkex_peak_rss_bytes " << peakRssBytes() << "\n";
+        out << "# HELP linkex_run_duration_seconds Wall-clock duration of the run.\n";
+        out << "# TYPE linkex_run_duration_seconds gauge\n";
+        out << "linkex_run_duration_seconds " << elapsed() << "\n";
+        out << "# HELP linkex_last_run_timestamp_seconds Unix time the metrics were written.\n";
+        out << "# TYPE linkex_last_run_timestamp_seconds gauge\n";
+        out << "linkex_last_run_timestamp_seconds " << std::time(nullptr) << "\n";
+        
+        return writeAtomically(path, out.str());
+    }
+
+private:
+    static constexpr size_t kTimingCount = 5;
+    static constexpr const char* kTimingNames[kTimingCount] = {
+        "namelookup", "connect", "appconnect", "starttransfer", "total"};
+    
+    static double timingOf(const RequestTiming& request, size_t index) {
+        switch (index) {
+            case 0: return request.nameLookup;
+            case 1: return request.connect;
+            case 2: return request.appConnect;
+            case 3: return request.startTransfer;
+            default: return request.total;
+        }
+    }
+    
+    void summarize(Phase (&totals)[kTimingCount], double& bytes, double& decoded) const {
+        for (const auto& request : requests_) {
+            for (size_t i = 0; i < kTimingCount; ++i) {
+                double value = timingOf(request, i);
+                ++totals[i].count;
+                totals[i].total += value;
+                totals[i].max = std::max(totals[i].max, value);
+            }
+            bytes += request.bytes;
+            decoded += request.decodedBytes;
+        }
+    }
+    
+    double elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+    }
+    
+    // JSON string; also valid as a Prometheus label value for the names used here
+    static std::string quote(const std::string& value) {
+        return StringUtils::quoteJson(value);
+    }
+    
+    static bool writeAtomically(const std::string& path, const std::string& content) {
+        std::string temp = path + ".tmp" + std::to_string(::getpid());
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return false;
+            file << content;
+            if (!file) {
+                std::remove(temp.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+};
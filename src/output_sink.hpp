@@ -0,0 +1,360 @@
+#pragma once
+
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "string_utils.hpp"
+
+// ============================================================================
+// OUTPUT SINKS
+// ============================================================================
+
+enum class OutputFormat { Text, JsonLines, Tsv, Urls };
+
+// Where output goes: a file, stdout when the path is "-", or a descriptor the
+// caller owns, such as a socket, optionally with HTTP/1.1 chunked framing
+class OutputFile {
+private:
+    int fd_ = -1;
+    bool owned_ = false;
+    bool chunked_ = false;
+    std::string error_;
+
+public:
+    OutputFile() = default;
+    ~OutputFile() { close(); }
+    
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+    
+    // Appending keeps what an earlier run wrote, and each write() lands whole
+    // even when several processes share the file
+    bool open(const std::string& path, bool append = false) {
+        close();
+        if (path == "-") {
+            fd_ = STDOUT_FILENO;
+            return true;
+        }
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC) | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            error_ = std::strerror(errno);
+            return false;
+        }
+        owned_ = true;
+        return true;
+    }
+    
+    // Writes to `fd` without taking ownership; chunked output needs finish()
+    void attach(int fd, bool chunked = false) {
+        close();
+        fd_ = fd;
+        chunked_ = chunked;
+    }
+    
+    // One write() for the whole buffer (with its chunk header and trailer)
+    // unless the kernel takes less. Concurrent batch jobs share stdout, so
+    // writes to it are serialized.
+    bool write(const char* data, size_t size) {
+        if (fd_ < 0) return false;
+        if (size == 0) return true; // An empty chunk would end a chunked body
+        std::unique_lock<std::mutex> lock(stdoutMutex(), std::defer_lock);
+        if (fd_ == STDOUT_FILENO) lock.lock();
+        
+        char header[24];
+        iovec parts[3];
+        int count = 0;
+        if (chunked_) {
+            int length = std::snprintf(header, sizeof(header), "%zx\r\n", size);
+            parts[count++] = {header, static_cast<size_t>(length)};
+        }
+        parts[count++] = {const_cast<char*>(data), size};
+        if (chunked_) {
+            parts[count++] = {const_cast<char*>("\r\n"), 2};
+        }
+        return writeAll(parts, count);
+    }
+    
+    bool write(const std::string& data) { return write(data.data(), data.size()); }
+    
+    // Ends a chunked body; without it the reader sees a truncated response
+    bool finish() {
+        if (!chunked_) return true;
+        iovec last = {const_cast<char*>("0\r\n\r\n"), 5};
+        return writeAll(&last, 1);
+    }
+    
+    bool close() {
+        bool closed = true;
+        if (owned_ && ::close(fd_) != 0) {
+            error_ = std::strerror(errno);
+            closed = false;
+        }
+        fd_ = -1;
+        owned_ = false;
+        return closed;
+    }
+    
+    const std::string& error() const { return error_; }
+
+private:
+    bool writeAll(iovec* parts, int count) {
+        while (count > 0) {
+            ssize_t written = ::writev(fd_, parts, count);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                error_ = std::strerror(errno);
+                return false;
+            }
+            // Skip what went out; a partial write resumes mid-part
+            size_t remaining = static_cast<size_t>(written);
+            while (count > 0 && remaining >= parts->iov_len) {
+                remaining -= parts->iov_len;
+                ++parts;
+                --count;
+            }
+            if (count > 0) {
+                parts->iov_base = static_cast<char*>(parts->iov_base) + remaining;
+                parts->iov_len -= remaining;
+            }
+        }
+        return true;
+    }
+    
+    static std::mutex& stdoutMutex() {
+        static std::mutex m;
+        return m;
+    }
+};
+
+// Renders one series' chapter records. Records accumulate in a buffer sized up
+// front by reserve() and reach the file in a single write on close(); in
+// streaming mode each record is written as soon as it is added instead.
+class ChapterSink {
+protected:
+    struct Series {
+        std::string title;
+        std::string source;
+        std::string generated;
+    };
+    
+    Series series_;
+    std::string buffer_;
+
+private:
+    std::shared_ptr<OutputFile> out_;
+    bool ownsOutput_ = false;
+    bool streaming_ = false;
+    bool failed_ = false;
+
+public:
+    virtual ~ChapterSink() = default;
+    
+    static std::unique_ptr<ChapterSink> create(OutputFormat format);
+    
+    static bool parseFormat(const std::string& name, OutputFormat& format) {
+        if (name == "txt" || name == "text") format = OutputFormat::Text;
+        else if (name == "jsonl") format = OutputFormat::JsonLines;
+        else if (name == "tsv") format = OutputFormat::Tsv;
+        else if (name == "urls") format = OutputFormat::Urls;
+        else return false;
+        return true;
+    }
+    
+    static const char* extension(OutputFormat format) {
+        switch (format) {
+            case OutputFormat::JsonLines: return ".jsonl";
+            case OutputFormat::Tsv:       return ".tsv";
+            case OutputFormat::Urls:      return ".urls";
+            default:                      return ".txt";
+        }
+    }
+    
+    // Only formats without a header that counts the chapters can stream
+    static bool canStream(OutputFormat format) { return format != OutputFormat::Text; }
+    
+    bool open(const std::string& path, bool streaming = false) {
+        out_ = std::make_shared<OutputFile>();
+        ownsOutput_ = true;
+        streaming_ = streaming;
+        failed_ = !out_->open(path);
+        return !failed_;
+    }
+    
+    // Writes into an output the caller keeps open after close()
+    void attach(std::shared_ptr<OutputFile> output, bool streaming = false) {
+        out_ = std::move(output);
+        ownsOutput_ = false;
+        streaming_ = streaming;
+        failed_ = false;
+    }
+    
+    // The title may change between records while streaming, once the page reveals it
+    void setSeries(const std::string& title, const std::string& source, const std::string& generated) {
+        series_ = Series{title, source, generated};
+        seriesChanged();
+    }
+    
+    // Presizes the buffer for `chapters` so adding them never reallocates
+    void reserve(const std::vector<std::string>& chapters) {
+        size_t size = headerSize();
+        for (const auto& url : chapters) {
+            size += url.size() + recordOverhead();
+        }
+        buffer_.reserve(size);
+    }
+    
+    // `total` is the number of records that follow
+    void header(size_t total) {
+        appendHeader(total);
+        flushIfStreaming();
+    }
+    
+    void add(size_t number, const std::string& url) {
+        appendRecord(number, url);
+        flushIfStreaming();
+    }
+    
+    // Writes what is buffered and closes the file; false if any write failed
+    bool close() {
+        if (!buffer_.empty()) flush();
+        bool closed = !ownsOutput_ || out_->close();
+        return closed && !failed_;
+    }
+    
+    const std::string& error() const { return out_->error(); }
+
+protected:
+    virtual void seriesChanged() {}
+    virtual size_t headerSize() const { return 0; }
+    virtual size_t recordOverhead() const = 0; // Bytes per record besides the URL
+    virtual void appendHeader(size_t) {}
+    virtual void appendRecord(size_t number, const std::string& url) = 0;
+    
+    void appendNumber(size_t value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer_.append(digits, result.ptr);
+    }
+
+private:
+    void flushIfStreaming() {
+        if (streaming_) flush();
+    }
+    
+    void flush() {
+        if (!failed_ && !out_->write(buffer_)) failed_ = true;
+        buffer_.clear();
+    }
+};
+
+// The original format: a commented metadata header, then "# Chapter N" and the URL
+class TextSink : public ChapterSink {
+protected:
+    size_t headerSize() const override {
+        return 200 + series_.title.size() + series_.source.size();
+    }
+    
+    size_t recordOverhead() const override { return 24; }
+    
+    void appendHeader(size_t total) override {
+        buffer_ += "# Manga Chapter Links\n# Title: ";
+        buffer_ += series_.title;
+        buffer_ += "\n# Source: ";
+        buffer_ += series_.source;
+        buffer_ += "\n# Total Chapters: ";
+        appendNumber(total);
+        buffer_ += "\n# Generated: ";
+        buffer_ += series_.generated;
+        buffer_ += "\n# ==========================================\n\n";
+    }
+    
+    void appendRecord(size_t number, const std::string& url) override {
+        buffer_ += "# Chapter ";
+        appendNumber(number);
+        buffer_ += '\n';
+        buffer_ += url;
+        buffer_ += "\n\n";
+    }
+};
+
+// {"source":"…","title":"…","chapter":N,"url":"…"} per line
+class JsonLinesSink : public ChapterSink {
+private:
+    std::string prefix_; // Everything up to the chapter number, escaped once per series
+
+protected:
+    void seriesChanged() override {
+        prefix_ = "{\"source\":" + StringUtils::quoteJson(series_.source) +
+                  ",\"title\":" + StringUtils::quoteJson(series_.title) + ",\"chapter\":";
+    }
+    
+    size_t recordOverhead() const override { return prefix_.size() + 32; }
+    
+    void appendRecord(size_t number, const std::string& url) override {
+        buffer_ += prefix_;
+        appendNumber(number);
+        buffer_ += ",\"url\":";
+        buffer_ += StringUtils::quoteJson(url);
+        buffer_ += "}\n";
+    }
+};
+
+// source, title, chapter number and URL separated by tabs, no header row, so
+// the output of several series can simply be concatenated
+class TsvSink : public ChapterSink {
+private:
+    std::string prefix_;
+
+protected:
+    void seriesChanged() override {
+        prefix_ = field(series_.source) + '\t' + field(series_.title) + '\t';
+    }
+    
+    size_t recordOverhead() const override { return prefix_.size() + 24; }
+    
+    void appendRecord(size_t number, const std::string& url) override {
+        buffer_ += prefix_;
+        appendNumber(number);
+        buffer_ += '\t';
+        buffer_ += url;
+        buffer_ += '\n';
+    }
+
+private:
+    static std::string field(std::string value) {
+        for (char& c : value) {
+            if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+        }
+        return value;
+    }
+};
+
+// Bare URLs, one per line, for piping into a downloader
+class UrlListSink : public ChapterSink {
+protected:
+    size_t recordOverhead() const override { return 1; }
+    
+    void appendRecord(size_t, const std::string& url) override {
+        buffer_ += url;
+        buffer_ += '\n';
+    }
+};
+
+inline std::unique_ptr<ChapterSink> ChapterSink::create(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::JsonLines: return std::make_unique<JsonLinesSink>();
+        case OutputFormat::Tsv:       return std::make_unique<TsvSink>();
+        case OutputFormat::Urls:      return std::make_unique<UrlListSink>();
+        default:                      return std::make_unique<TextSink>();
+    }
+}
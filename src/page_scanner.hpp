@@ -0,0 +1,427 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// PAGE SCANNER
+// ============================================================================
+
+// Finds the byte ranges of a few elements, located by id, in a raw page
+// without tokenizing the rest of it, so only those ranges need a DOM. Any
+// markup the scan cannot delimit with certainty (a missing or repeated id, an
+// unclosed container, an element whose end tag is optional) makes it give up
+// and leaves the caller to parse the whole page.
+class PageScanner {
+public:
+    struct Range {
+        size_t begin = 0;
+        size_t end = 0; // One past the container's end tag
+    };
+    
+    // Ranges covering every <base> tag and the element carrying each of `ids`,
+    // in document order with nested ones folded into their container. False
+    // when the scan is ambiguous.
+    static bool scan(std::string_view html, const std::vector<std::string>& ids, std::vector<Range>& ranges) {
+        ranges.clear();
+        if (ids.empty()) return false;
+        
+        // Every place an id value occurs; the walk below keeps those inside an id attribute
+        std::vector<std::pair<size_t, size_t>> candidates;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (ids[i].empty()) return false;
+            for (size_t pos = find(html, ids[i]); pos != std::string_view::npos; pos = find(html, ids[i], pos + 1)) {
+                if (mayBeAttributeValue(html, pos, ids[i].size())) candidates.emplace_back(pos, i);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        
+        // Most tags are skipped by looking at the two bytes after their '<'
+        const Interest& outside = markupInterest();
+        Interest inside; // `outside` plus the open container's tag name
+        std::vector<size_t> found(ids.size(), 0);
+        size_t next = 0;
+        std::string_view container; // Tag name of the open range, empty outside
+        size_t depth = 0;
+        size_t pos = 0;
+        
+        while (pos < html.size()) {
+            while (next < candidates.size() && candidates[next].first < pos) ++next; // Skipped over
+            size_t lt = nextMarkup(html, pos, depth > 0 ? inside : outside);
+            if (lt != std::string_view::npos && inAttributeValue(html, lt)) {
+                pos = lt + 1;
+                continue;
+            }
+            if (next < candidates.size() && (lt == std::string_view::npos || candidates[next].first < lt)) {
+                // A skipped tag may still hold the next candidate
+                size_t at = candidates[next].first;
+                const void* open = memrchr(html.data() + pos, '<', at - pos);
+                if (!open) {
+                    ++next;
+                    continue;
+                }
+                lt = static_cast<const char*>(open) - html.data();
+            } else if (lt == std::string_view::npos) {
+                break;
+            }
+            while (next < candidates.size() && candidates[next].first < lt) ++next; // In text, not a tag
+            
+            char after = lt + 1 < html.size() ? html[lt + 1] : '\0';
+            if (after == '!' || after == '?') {
+                bool comment = html.substr(lt + 2, 2) == "--";
+                size_t end = comment ? find(html, "-->", lt + 4) : html.find('>', lt);
+                if (end == std::string_view::npos) break;
+                pos = end + (comment ? 3 : 1);
+                continue;
+            }
+            
+            bool endTag = after == '/';
+            std::string_view name = tagName(html, lt + (endTag ? 2 : 1));
+            if (name.empty()) {
+                pos = lt + 1; // A stray '<' is text
+                continue;
+            }
+            
+            size_t gt = tagEnd(html, lt);
+            if (gt == std::string_view::npos) break;
+            
+            if (endTag) {
+                if (depth > 0 && equalsIgnoreCase(name, container) && --depth == 0) {
+                    ranges.back().end = gt + 1;
+                    container = {};
+                }
+                pos = gt + 1;
+                continue;
+            }
+            
+            bool opened = false;
+            for (; next < candidates.size() && candidates[next].first < gt; ++next) {
+                size_t at = candidates[next].first;
+                size_t id = candidates[next].second;
+                std::string_view value = attribute(html, lt + 1 + name.size(), gt, "id");
+                if (value.data() != html.data() + at || value.size() != ids[id].size()) continue;
+                if (found[id]++ > 0) return false; // Duplicate id: which one a selector means is up to the parser
+                if (depth > 0) continue;           // Inside another container's range already
+                if (!isSelfContained(name)) return false;
+                ranges.push_back({lt, std::string_view::npos});
+                container = name;
+                depth = 1;
+                opened = true;
+                inside = outside;
+                addTagInterest(inside, name);
+            }
+            if (!opened && depth > 0 && equalsIgnoreCase(name, container)) ++depth;
+            if (depth == 0 && equalsIgnoreCase(name, "base")) ranges.push_back({lt, gt + 1});
+            
+            pos = gt + 1;
+            if (isRawText(name)) {
+                pos = rawTextEnd(html, pos, name);
+                if (pos == std::string_view::npos) break;
+            }
+        }
+        
+        if (depth > 0) return false;
+        for (size_t count : found) {
+            if (count != 1) return false;
+        }
+        return true;
+    }
+    
+    // First occurrence of `needle` at or after `from`. Compares the needle's
+    // first and last bytes against a whole vector of positions at once and
+    // only memcmp()s the ones where both match.
+    static size_t find(std::string_view haystack, std::string_view needle, size_t from = 0) {
+        size_t length = needle.size();
+        if (length < 2 || from >= haystack.size() || haystack.size() - from < length) {
+            return haystack.find(needle, from);
+        }
+        const char* text = haystack.data();
+        size_t last = haystack.size() - length; // Last possible match position
+        size_t pos = from;
+
+#if defined(__AVX2__)
+        const __m256i firstByte = _mm256_set1_epi8(needle.front());
+        const __m256i lastByte = _mm256_set1_epi8(needle.back());
+        for (; pos + 32 <= last + 1; pos += 32) {
+            __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos));
+            __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos + length - 1));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(head, firstByte), _mm256_cmpeq_epi8(tail, lastByte))));
+            for (; mask != 0; mask &= mask - 1) {
+                size_t at = pos + __builtin_ctz(mask);
+                if (std::memcmp(text + at + 1, needle.data() + 1, length - 2) == 0) return at;
+            }
+        }
+#elif defined(__SSE2__)
+        const __m128i firstByte = _mm_set1_epi8(needle.front());
+        const __m128i lastByte = _mm_set1_epi8(needle.back());
+        for (; pos + 16 <= last + 1; pos += 16) {
+            __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+            __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos + length - 1));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(head, firstByte), _mm_cmpeq_epi8(tail, lastByte))));
+            for (; mask != 0; mask &= mask - 1) {
+                size_t at = pos + __builtin_ctz(mask);
+                if (std::memcmp(text + at + 1, needle.data() + 1, length - 2) == 0) return at;
+            }
+        }
+#endif
+        // Scalar: the tail of a vectorized search, or the whole of it elsewhere
+        for (; pos <= last; ++pos) {
+            if (text[pos] == needle.front() && text[pos + length - 1] == needle.back() &&
+                std::memcmp(text + pos + 1, needle.data() + 1, length - 2) == 0) {
+                return pos;
+            }
+        }
+        return std::string_view::npos;
+    }
+    
+    // Vector width find() was compiled for
+    static const char* instructionSet() {
+#if defined(__AVX2__)
+        return "AVX2";
+#elif defined(__SSE2__)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+private:
+    // Elements whose content is not markup
+    static constexpr std::string_view kRawTextTags[] = {
+        "script", "style", "textarea", "title", "xmp", "iframe", "noembed", "noframes"
+    };
+    
+    // Indexed by the two bytes after a '<', lowercased
+    using Interest = std::bitset<1 << 16>;
+    
+    static void addTagInterest(Interest& interest, std::string_view name) {
+        unsigned first = static_cast<unsigned char>(lower(name[0]));
+        for (unsigned second = 0; second < 256; ++second) {
+            if (name.size() == 1 || second == static_cast<unsigned char>(lower(name[1]))) {
+                interest.set(first << 8 | second);
+            }
+        }
+        interest.set('/' << 8 | first);
+    }
+    
+    // Comments, declarations, raw text elements and <base>
+    static const Interest& markupInterest() {
+        static const Interest interest = [] {
+            Interest table;
+            for (unsigned second = 0; second < 256; ++second) {
+                table.set('!' << 8 | second);
+                table.set('?' << 8 | second);
+            }
+            for (std::string_view name : kRawTextTags) {
+                table.set(static_cast<unsigned>(name[0]) << 8 | static_cast<unsigned>(name[1]));
+            }
+            table.set('b' << 8 | 'a');
+            return table;
+        }();
+        return interest;
+    }
+    
+    // Next '<' at or after `from` whose following bytes `interest` selects
+    static size_t nextMarkup(std::string_view html, size_t from, const Interest& interest) {
+        const char* text = html.data();
+        size_t size = html.size();
+        auto selected = [&](size_t lt) {
+            unsigned first = lt + 1 < size ? static_cast<unsigned char>(lower(text[lt + 1])) : 0;
+            unsigned second = lt + 2 < size ? static_cast<unsigned char>(lower(text[lt + 2])) : 0;
+            return interest[first << 8 | second];
+        };
+        size_t pos = from;
+#if defined(__AVX2__)
+        const __m256i open = _mm256_set1_epi8('<');
+        for (; pos + 32 <= size; pos += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, open)));
+            for (; mask != 0; mask &= mask - 1) {
+                size_t lt = pos + __builtin_ctz(mask);
+                if (selected(lt)) return lt;
+            }
+        }
+#elif defined(__SSE2__)
+        const __m128i open = _mm_set1_epi8('<');
+        for (; pos + 16 <= size; pos += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, open)));
+            for (; mask != 0; mask &= mask - 1) {
+                size_t lt = pos + __builtin_ctz(mask);
+                if (selected(lt)) return lt;
+            }
+        }
+#endif
+        for (; pos < size; ++pos) {
+            if (text[pos] == '<' && selected(pos)) return pos;
+        }
+        return std::string_view::npos;
+    }
+    
+    // Whether the '<' at `lt` is quoted inside another tag, going by whichever
+    // of '<' and '>' comes before it
+    static bool inAttributeValue(std::string_view html, size_t lt) {
+        for (size_t pos = lt; pos > 0; --pos) {
+            if (html[pos - 1] == '>') return false;
+            if (html[pos - 1] == '<') return true;
+        }
+        return false;
+    }
+    
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+    }
+    
+    // ASCII only, called for every tag: strncasecmp() consults the locale
+    static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (lower(a[i]) != lower(b[i])) return false;
+        }
+        return true;
+    }
+    
+    static char lower(char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+    
+    // Cheap filter before the walk: quoted, or unquoted right after '='
+    static bool mayBeAttributeValue(std::string_view html, size_t pos, size_t length) {
+        if (pos == 0 || pos + length >= html.size()) return false;
+        char before = html[pos - 1];
+        char after = html[pos + length];
+        if (before == '"' || before == '\'') return after == before;
+        return (before == '=' || isSpace(before)) && (after == '>' || isSpace(after));
+    }
+    
+    static std::string_view tagName(std::string_view html, size_t from) {
+        if (from >= html.size() || !std::isalpha(static_cast<unsigned char>(html[from]))) return {};
+        size_t end = from + 1;
+        while (end < html.size() && !isSpace(html[end]) && html[end] != '/' && html[end] != '>') ++end;
+        return html.substr(from, end - from);
+    }
+    
+    // The '>' closing the tag at `lt`, skipping any inside quoted attribute values
+    static size_t tagEnd(std::string_view html, size_t lt) {
+        for (size_t pos = lt + 1;;) {
+            pos = findTagDelimiter(html, pos);
+            if (pos == std::string_view::npos || html[pos] == '>') return pos;
+            const void* quote = std::memchr(html.data() + pos + 1, html[pos], html.size() - pos - 1);
+            if (!quote) return std::string_view::npos;
+            pos = static_cast<const char*>(quote) - html.data() + 1;
+        }
+    }
+    
+    // First '>', '"' or '\'' at or after `from`
+    static size_t findTagDelimiter(std::string_view html, size_t from) {
+        const char* text = html.data();
+        size_t pos = from;
+#if defined(__AVX2__)
+        const __m256i close = _mm256_set1_epi8('>');
+        const __m256i doubleQuote = _mm256_set1_epi8('"');
+        const __m256i singleQuote = _mm256_set1_epi8('\'');
+        for (; pos + 32 <= html.size(); pos += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos));
+            __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, close),
+                                           _mm256_or_si256(_mm256_cmpeq_epi8(block, doubleQuote),
+                                                           _mm256_cmpeq_epi8(block, singleQuote)));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+            if (mask != 0) return pos + __builtin_ctz(mask);
+        }
+#elif defined(__SSE2__)
+        const __m128i close = _mm_set1_epi8('>');
+        const __m128i doubleQuote = _mm_set1_epi8('"');
+        const __m128i singleQuote = _mm_set1_epi8('\'');
+        for (; pos + 16 <= html.size(); pos += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+            __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, close),
+                                        _mm_or_si128(_mm_cmpeq_epi8(block, doubleQuote),
+                                                     _mm_cmpeq_epi8(block, singleQuote)));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+            if (mask != 0) return pos + __builtin_ctz(mask);
+        }
+#endif
+        for (; pos < html.size(); ++pos) {
+            if (text[pos] == '>' || text[pos] == '"' || text[pos] == '\'') return pos;
+        }
+        return std::string_view::npos;
+    }
+    
+    // Value of the first `wanted` attribute in html[from, to), a view into the page
+    static std::string_view attribute(std::string_view html, size_t from, size_t to, std::string_view wanted) {
+        size_t pos = from;
+        while (pos < to) {
+            while (pos < to && (isSpace(html[pos]) || html[pos] == '/')) ++pos;
+            size_t nameStart = pos;
+            while (pos < to && html[pos] != '=' && html[pos] != '/' && !isSpace(html[pos])) ++pos;
+            std::string_view name = html.substr(nameStart, pos - nameStart);
+            while (pos < to && isSpace(html[pos])) ++pos;
+            
+            std::string_view value;
+            if (pos < to && html[pos] == '=') {
+                ++pos;
+                while (pos < to && isSpace(html[pos])) ++pos;
+                size_t valueStart = pos;
+                if (pos < to && (html[pos] == '"' || html[pos] == '\'')) {
+                    char quote = html[pos++];
+                    valueStart = pos;
+                    while (pos < to && html[pos] != quote) ++pos;
+                    value = html.substr(valueStart, pos - valueStart);
+                    if (pos < to) ++pos;
+                } else {
+                    while (pos < to && !isSpace(html[pos])) ++pos;
+                    value = html.substr(valueStart, pos - valueStart);
+                }
+            }
+            
+            if (equalsIgnoreCase(name, wanted)) return value;
+            if (name.empty() && value.empty()) ++pos; // Skip unparseable characters
+        }
+        return {};
+    }
+    
+    static bool isRawText(std::string_view name) {
+        for (std::string_view tag : kRawTextTags) {
+            if (equalsIgnoreCase(name, tag)) return true;
+        }
+        return false;
+    }
+    
+    // Position after the end tag of the raw text element whose content starts at `from`
+    static size_t rawTextEnd(std::string_view html, size_t from, std::string_view name) {
+        for (size_t pos = html.find("</", from); pos != std::string_view::npos; pos = html.find("</", pos + 2)) {
+            if (equalsIgnoreCase(html.substr(pos + 2, name.size()), name)) {
+                size_t gt = html.find('>', pos);
+                return gt == std::string_view::npos ? gt : gt + 1;
+            }
+        }
+        return std::string_view::npos;
+    }
+    
+    // Whether the element parses the same on its own as in the page: it has a
+    // required end tag and is not bound to a table, list or document structure
+    static bool isSelfContained(std::string_view name) {
+        static const std::string_view contextual[] = {
+            "html", "head", "body", "template", "frameset", "frame",
+            "li", "dd", "dt", "p", "option", "optgroup", "rb", "rp", "rt", "rtc",
+            "caption", "colgroup", "col", "thead", "tbody", "tfoot", "tr", "td", "th",
+            "area", "base", "br", "embed", "hr", "img", "input", "link", "meta", "param", "source", "track", "wbr"
+        };
+        for (std::string_view tag : contextual) {
+            if (equalsIgnoreCase(name, tag)) return false;
+        }
+        return !isRawText(name);
+    }
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "logger.hpp"
+
+// ============================================================================
+// RATE LIMITER
+// ============================================================================
+
+struct RateLimitOptions {
+    double requestsPerSecond = 10.0; // Token refill rate per host, 0 = no pacing
+    double burst = 10.0;             // Bucket size
+    size_t initialConcurrency = 4;
+    size_t maxConcurrency = 16;
+    double latencySpikeFactor = 3.0; // Time to first byte this many times the host average counts as overload
+};
+
+// Per-host pacing: a token bucket caps the request rate, and an AIMD window caps
+// requests in flight. The window grows by one per window's worth of healthy
+// responses and halves on 429/503, timeouts or a latency spike, at most once per
+// round of requests. Retry-After pauses the host entirely.
+class RateLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    // One admitted request; hand it back to complete()
+    struct Permit {
+        std::string host;
+        Clock::time_point started;
+    };
+    
+    enum class Outcome { Healthy, Overloaded, Failed };
+    
+    struct Stats {
+        size_t backoffs = 0;
+        double waitedSeconds = 0.0; // Total time requests spent waiting for admission
+    };
+    
+    // Told the host whenever complete() frees a slot, on the completing thread
+    using SlotFreed = std::function<void(const std::string& host)>;
+
+private:
+    struct Host {
+        std::mutex mutex;
+        std::condition_variable admitted;
+        double tokens;
+        Clock::time_point refilled;
+        double window;
+        size_t inFlight = 0;
+        Clock::time_point pausedUntil;
+        Clock::time_point lastBackoff;
+        double averageTtfb = 0.0; // Seconds, exponentially weighted
+        size_t samples = 0;
+    };
+    
+    RateLimitOptions options_;
+    std::mutex hostsMutex_;
+    std::unordered_map<std::string, std::unique_ptr<Host>> hosts_;
+    std::atomic<size_t> backoffs_{0};
+    std::atomic<int64_t> waitedMicros_{0};
+    SlotFreed slotFreed_;
+
+public:
+    explicit RateLimiter(const RateLimitOptions& options = RateLimitOptions()) : options_(options) {
+        options_.maxConcurrency = std::max<size_t>(1, options_.maxConcurrency);
+        options_.initialConcurrency = std::clamp<size_t>(options_.initialConcurrency, 1, options_.maxConcurrency);
+        options_.burst = std::max(1.0, options_.burst);
+    }
+    
+    // For event loops holding requests that tryAcquire() turned away; set before
+    // the first request
+    void onSlotFreed(SlotFreed callback) { slotFreed_ = std::move(callback); }
+    
+    // Blocks until `host` has a free slot in its window and a token in its bucket
+    Permit acquire(const std::string& host) {
+        Host& state = hostState(host);
+        auto start = Clock::now();
+        
+        std::unique_lock<std::mutex> lock(state.mutex);
+        Clock::time_point retryAt;
+        while (!admissible(state, Clock::now(), retryAt)) {
+            if (retryAt == Clock::time_point::max()) {
+                state.admitted.wait(lock);
+            } else {
+                state.admitted.wait_until(lock, retryAt);
+            }
+        }
+        return admit(state, host, start);
+    }
+    
+    // acquire() for event loops, which cannot wait. On false, `retryAt` is when
+    // the host can take another request, or time_point::max() if that depends
+    // on a request in flight completing. `queued` is when the request first
+    // asked, for the waiting-time stats.
+    bool tryAcquire(const std::string& host, Clock::time_point queued, Permit& permit, Clock::time_point& retryAt) {
+        Host& state = hostState(host);
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!admissible(state, Clock::now(), retryAt)) return false;
+        permit = admit(state, host, queued);
+        return true;
+    }
+    
+    // `ttfb` is the time to first byte in seconds; `retryAfter` the server's
+    // requested pause in seconds, 0 if none
+    void complete(const Permit& permit, Outcome outcome, double ttfb, double retryAfter = 0.0) {
+        Host& state = hostState(permit.host);
+        std::unique_lock<std::mutex> lock(state.mutex);
+        --state.inFlight;
+        
+        auto now = Clock::now();
+        if (retryAfter > 0) {
+            auto until = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(retryAfter));
+            if (until > state.pausedUntil) {
+                state.pausedUntil = until;
+                Logger::warning(permit.host + ": server asked to retry after " + seconds(retryAfter) +
+                                ", pausing requests");
+            }
+        }
+        
+        bool spike = false;
+        if (outcome != Outcome::Failed && ttfb > 0) {
+            spike = state.samples >= 5 && ttfb > options_.latencySpikeFactor * state.averageTtfb && ttfb > 0.5;
+            state.averageTtfb = state.samples == 0 ? ttfb : 0.8 * state.averageTtfb + 0.2 * ttfb;
+            ++state.samples;
+        }
+        
+        if (outcome == Outcome::Overloaded || spike) {
+            // Responses to requests sent before the last back-off describe the old window
+            if (permit.started >= state.lastBackoff) {
+                double previous = state.window;
+                state.window = std::max(1.0, std::floor(state.window / 2));
+                state.lastBackoff = now;
+                ++backoffs_;
+                Logger::warning(permit.host + ": " + (spike ? "latency spike (" + seconds(ttfb) + " to first byte)" : "overloaded") +
+                                ", concurrency " + std::to_string(static_cast<size_t>(previous)) + " -> " +
+                                std::to_string(static_cast<size_t>(state.window)));
+            }
+        } else if (outcome == Outcome::Healthy && state.window < options_.maxConcurrency) {
+            size_t previous = static_cast<size_t>(state.window);
+            state.window = std::min<double>(options_.maxConcurrency, state.window + 1.0 / state.window);
+            if (static_cast<size_t>(state.window) > previous) {
+                Logger::info(permit.host + ": concurrency " + std::to_string(previous) + " -> " +
+                             std::to_string(static_cast<size_t>(state.window)));
+            }
+        }
+        
+        state.admitted.notify_all();
+        lock.unlock();
+        if (slotFreed_) slotFreed_(permit.host);
+    }
+    
+    // Current window of `host`, or the initial one if it has not been seen
+    size_t concurrency(const std::string& host) {
+        Host& state = hostState(host);
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return static_cast<size_t>(state.window);
+    }
+    
+    Stats stats() const {
+        Stats s;
+        s.backoffs = backoffs_;
+        s.waitedSeconds = waitedMicros_ / 1e6;
+        return s;
+    }
+
+private:
+    Host& hostState(const std::string& host) {
+        std::lock_guard<std::mutex> lock(hostsMutex_);
+        auto& slot = hosts_[host];
+        if (!slot) {
+            slot = std::make_unique<Host>();
+            slot->tokens = options_.burst;
+            slot->refilled = Clock::now();
+            slot->window = static_cast<double>(options_.initialConcurrency);
+        }
+        return *slot;
+    }
+    
+    // Called with state.mutex held
+    bool admissible(Host& state, Clock::time_point now, Clock::time_point& retryAt) const {
+        refill(state, now);
+        if (now < state.pausedUntil) {
+            retryAt = state.pausedUntil;
+        } else if (state.inFlight >= static_cast<size_t>(state.window)) {
+            retryAt = Clock::time_point::max();
+        } else if (options_.requestsPerSecond > 0 && state.tokens < 1.0) {
+            auto missing = std::chrono::duration<double>((1.0 - state.tokens) / options_.requestsPerSecond);
+            retryAt = now + std::chrono::duration_cast<Clock::duration>(missing);
+        } else {
+            return true;
+        }
+        return false;
+    }
+    
+    // Called with state.mutex held, once admissible() agreed
+    Permit admit(Host& state, const std::string& host, Clock::time_point start) {
+        if (options_.requestsPerSecond > 0) state.tokens -= 1.0;
+        ++state.inFlight;
+        
+        auto now = Clock::now();
+        waitedMicros_ += std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+        return Permit{host, now};
+    }
+    
+    void refill(Host& state, Clock::time_point now) const {
+        double elapsed = std::chrono::duration<double>(now - state.refilled).count();
+        state.tokens = std::min(options_.burst, state.tokens + elapsed * options_.requestsPerSecond);
+        state.refilled = now;
+    }
+    
+    static std::string seconds(double value) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2) << value << "s";
+        return out.str();
+    }
+};
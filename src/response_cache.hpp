@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "string_utils.hpp"
+
+// ============================================================================
+// RESPONSE CACHE
+// ============================================================================
+
+// Read-only view of a whole file, memory-mapped when possible and read into
+// memory otherwise (empty files, filesystems without mmap)
+class MappedFile {
+private:
+    void* map_ = nullptr;
+    size_t size_ = 0;
+    std::string fallback_;
+    bool open_ = false;
+    
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        
+        struct stat info {};
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* map = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                map_ = map;
+                size_ = static_cast<size_t>(info.st_size);
+                open_ = true;
+            }
+        }
+        ::close(fd);
+        
+        if (!open_) {
+            std::ifstream file(path, std::ios::binary);
+            if (file.is_open()) {
+                fallback_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                open_ = true;
+            }
+        }
+    }
+    
+    ~MappedFile() {
+        if (map_) ::munmap(map_, size_);
+    }
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    bool isOpen() const { return open_; }
+    bool isMapped() const { return map_ != nullptr; }
+    
+    std::string_view data() const {
+        return map_ ? std::string_view(static_cast<const char*>(map_), size_) : std::string_view(fallback_);
+    }
+};
+
+// On-disk response cache keyed by URL. Each entry is a body file plus a small
+// metadata file holding the validators (ETag / Last-Modified) used to
+// revalidate it with a conditional request.
+class ResponseCache {
+public:
+    struct Entry {
+        std::string etag;
+        std::string lastModified;
+        
+        bool empty() const { return etag.empty() && lastModified.empty(); }
+    };
+    
+    struct Stats {
+        size_t hits = 0;          // 304 Not Modified, body served from disk
+        size_t refreshed = 0;     // Revalidation returned a new body
+        size_t misses = 0;        // No usable entry, unconditional request
+        size_t stores = 0;        // Bodies written with their validators
+    };
+    
+    // Streams a body into the cache; nothing is visible until commit()
+    class Writer {
+    private:
+        ResponseCache* cache_;
+        std::string url_;
+        std::string tempPath_;
+        std::ofstream file_;
+        
+    public:
+        Writer(ResponseCache* cache, const std::string& url)
+            : cache_(cache), url_(url), tempPath_(cache->bodyPath(url) + tempSuffix()) {
+            file_.open(tempPath_, std::ios::binary | std::ios::trunc);
+        }
+        
+        ~Writer() {
+            if (file_.is_open()) {
+                file_.close();
+                std::remove(tempPath_.c_str());
+            }
+        }
+        
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+        
+        void append(const char* data, size_t size) {
+            if (file_.is_open()) file_.write(data, static_cast<std::streamsize>(size));
+        }
+        
+        // A body without validators could never be revalidated, so it is not
+        // kept, and neither is an older entry for the same URL
+        bool commit(const Entry& entry) {
+            if (!file_.is_open()) return false;
+            file_.close();
+            if (entry.empty()) {
+                std::remove(tempPath_.c_str());
+                cache_->remove(url_);
+                return false;
+            }
+            // Drop the old validators first so they can never describe the new body
+            std::remove(cache_->metaPath(url_).c_str());
+            if (!file_ || std::rename(tempPath_.c_str(), cache_->bodyPath(url_).c_str()) != 0) {
+                std::remove(tempPath_.c_str());
+                return false;
+            }
+            return cache_->writeMeta(url_, entry);
+        }
+    };
+    
+private:
+    std::string dir_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> refreshed_{0};
+    std::atomic<size_t> misses_{0};
+    std::atomic<size_t> stores_{0};
+    
+public:
+    explicit ResponseCache(const std::string& dir) : dir_(dir) {
+        std::error_code ec;
+        std::filesystem::create_directories(dir_, ec);
+        if (ec) {
+            throw std::runtime_error("Could not create cache directory " + dir_ + ": " + ec.message());
+        }
+    }
+    
+    const std::string& dir() const { return dir_; }
+    
+    // Finds validators for url; entries without any validator are useless and ignored
+    bool lookup(const std::string& url, Entry& entry) const {
+        std::ifstream meta(metaPath(url));
+        if (!meta.is_open()) return false;
+        
+        std::string line;
+        std::string storedUrl;
+        while (std::getline(meta, line)) {
+            size_t space = line.find(' ');
+            if (space == std::string::npos) continue;
+            std::string key = line.substr(0, space);
+            std::string value = line.substr(space + 1);
+            if (key == "url") storedUrl = value;
+            else if (key == "etag") entry.etag = value;
+            else if (key == "last-modified") entry.lastModified = value;
+        }
+        
+        return storedUrl == url && !entry.empty() &&
+               std::filesystem::exists(bodyPath(url));
+    }
+    
+    std::shared_ptr<const MappedFile> openBody(const std::string& url) const {
+        auto body = std::make_shared<const MappedFile>(bodyPath(url));
+        return body->isOpen() ? body : nullptr;
+    }
+    
+    bool store(const std::string& url, const Entry& entry, std::string_view body) {
+        if (entry.empty()) {
+            remove(url);
+            return false;
+        }
+        Writer writer(this, url);
+        writer.append(body.data(), body.size());
+        return writer.commit(entry);
+    }
+    
+    void remove(const std::string& url) {
+        std::remove(metaPath(url).c_str());
+        std::remove(bodyPath(url).c_str());
+    }
+    
+    void recordHit() { ++hits_; }
+    void recordRefresh() { ++refreshed_; }
+    void recordMiss() { ++misses_; }
+    
+    Stats stats() const {
+        Stats s;
+        s.hits = hits_;
+        s.refreshed = refreshed_;
+        s.misses = misses_;
+        s.stores = stores_;
+        return s;
+    }
+    
+private:
+    // Unique per process and write, so concurrent jobs never share a temp file
+    static std::string tempSuffix() {
+        static std::atomic<size_t> counter{0};
+        return ".part." + std::to_string(::getpid()) + "." + std::to_string(counter++);
+    }
+    
+    // Collisions are caught by the URL stored in the metadata
+    static std::string key(const std::string& url) {
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(StringUtils::stableHash(url)));
+        return hex;
+    }
+    
+    std::string metaPath(const std::string& url) const {
+        return (std::filesystem::path(dir_) / (key(url) + ".meta")).string();
+    }
+    
+    std::string bodyPath(const std::string& url) const {
+        return (std::filesystem::path(dir_) / (key(url) + ".body")).string();
+    }
+    
+    bool writeMeta(const std::string& url, const Entry& entry) {
+        std::string path = metaPath(url);
+        std::string temp = path + tempSuffix();
+        {
+            std::ofstream meta(temp, std::ios::trunc);
+            if (!meta.is_open()) return false;
+            meta << "url " << url << "\n";
+            if (!entry.etag.empty()) meta << "etag " << entry.etag << "\n";
+            if (!entry.lastModified.empty()) meta << "last-modified " << entry.lastModified << "\n";
+            if (!meta.good()) return false;
+        }
+        if (std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        ++stores_;
+        return true;
+    }
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include <curl/curl.h>
+
+// ============================================================================
+// RETRY POLICY
+// ============================================================================
+
+struct RetryOptions {
+    size_t maxRetries = 3;
+    std::chrono::milliseconds baseDelay{250};
+    std::chrono::milliseconds maxDelay{8000};
+    bool hedge = false;           // Duplicate a get() that outlives the observed p95 latency
+    size_t hedgeMinSamples = 20;  // Latencies needed before the p95 is trusted
+};
+
+class RetryPolicy {
+private:
+    RetryOptions options_;
+
+public:
+    explicit RetryPolicy(const RetryOptions& options = RetryOptions()) : options_(options) {}
+    
+    const RetryOptions& options() const { return options_; }
+    
+    // Transient network failures and overload statuses are worth another try;
+    // everything else (4xx, bad URLs, certificate problems) fails the same way again
+    static bool retryable(CURLcode code, long status) {
+        switch (code) {
+            case CURLE_OK:
+                break;
+            case CURLE_COULDNT_RESOLVE_HOST:
+            case CURLE_COULDNT_CONNECT:
+            case CURLE_OPERATION_TIMEDOUT:
+            case CURLE_SEND_ERROR:
+            case CURLE_RECV_ERROR:
+            case CURLE_GOT_NOTHING:
+            case CURLE_PARTIAL_FILE:
+            case CURLE_SSL_CONNECT_ERROR:
+            case CURLE_HTTP2:
+            case CURLE_HTTP2_STREAM:
+                return true;
+            default:
+                return false;
+        }
+        
+        switch (status) {
+            case 408: case 425: case 429:
+            case 500: case 502: case 503: case 504:
+                return true;
+            default:
+                return false;
+        }
+    }
+    
+    // Equal jitter: half of the exponential step is fixed, the other half random,
+    // so concurrent failures spread out without ever retrying immediately
+    std::chrono::milliseconds delay(size_t retry) const {
+        auto step = options_.baseDelay.count() << std::min<size_t>(retry, 20);
+        step = std::min<decltype(step)>(step, options_.maxDelay.count());
+        
+        thread_local std::mt19937 rng{std::random_device{}()};
+        std::uniform_int_distribution<decltype(step)> jitter(0, step / 2);
+        return std::chrono::milliseconds(step - step / 2 + jitter(rng));
+    }
+};
+
+// Latencies of the most recent successful transfers, for hedging decisions
+class LatencyTracker {
+private:
+    mutable std::mutex mutex_;
+    std::deque<double> samples_;
+    size_t capacity_;
+
+public:
+    explicit LatencyTracker(size_t capacity = 256) : capacity_(capacity) {}
+    
+    void record(double seconds) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        samples_.push_back(seconds);
+        if (samples_.size() > capacity_) samples_.pop_front();
+    }
+    
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return samples_.size();
+    }
+    
+    // Seconds below which `fraction` of the recorded transfers finished, 0 if none
+    double percentile(double fraction) const {
+        std::vector<double> sorted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sorted.assign(samples_.begin(), samples_.end());
+        }
+        if (sorted.empty()) return 0.0;
+        
+        size_t rank = std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return sorted[rank];
+    }
+};
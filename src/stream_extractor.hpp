@@ -0,0 +1,303 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <strings.h>
+
+#include "string_utils.hpp"
+
+// ============================================================================
+// STREAMING EXTRACTOR
+// ============================================================================
+
+// Incremental tokenizer for streamed pages. Emits every <a href> inside the
+// chapter container (#chapters-list) and the first <h1> inside the title
+// container (#manga-info-rightColumn) without building a DOM, so extraction
+// runs while the body is still downloading.
+class ChapterStreamExtractor {
+public:
+    using LinkHandler = std::function<void(const std::string& href)>;
+
+private:
+    LinkHandler onLink_;
+    std::string chaptersId_;
+    std::string titleId_;
+    std::string buffer_;                 // Unconsumed input, at most one partial token
+    std::vector<std::string> openTags_;  // Open elements, used to find where containers end
+    size_t chaptersDepth_ = 0;           // openTags_ size at #chapters-list, 0 = outside
+    size_t infoDepth_ = 0;               // openTags_ size at #manga-info-rightColumn
+    size_t titleDepth_ = 0;              // openTags_ size at the title <h1>
+    std::string rawTextTag_;             // Set while inside <script>/<style>
+    std::string title_;
+    std::string baseHref_;               // First <base href>, which relative links resolve against
+    bool titleFound_ = false;
+    bool chaptersSeen_ = false;
+    bool chaptersClosed_ = false;
+    size_t linkCount_ = 0;
+
+public:
+    ChapterStreamExtractor(const std::string& chaptersId, const std::string& titleId, LinkHandler onLink)
+        : onLink_(std::move(onLink)), chaptersId_(chaptersId), titleId_(titleId), titleFound_(titleId.empty()) {}
+    
+    // Returns false once nothing more is needed from the document
+    bool feed(const char* data, size_t size) {
+        buffer_.append(data, size);
+        size_t pos = 0;
+        
+        while (pos < buffer_.size()) {
+            if (!rawTextTag_.empty()) {
+                size_t end = findEndTag(pos, rawTextTag_);
+                if (end == std::string::npos) {
+                    // Keep just enough to recognise a closing tag split across chunks
+                    size_t keep = rawTextTag_.size() + 2;
+                    pos = buffer_.size() > keep ? std::max(pos, buffer_.size() - keep) : pos;
+                    break;
+                }
+                rawTextTag_.clear();
+                pos = end;
+                continue;
+            }
+            
+            size_t lt = buffer_.find('<', pos);
+            if (lt == std::string::npos) {
+                appendText(pos, buffer_.size());
+                pos = buffer_.size();
+                break;
+            }
+            appendText(pos, lt);
+            pos = lt;
+            
+            size_t next = consumeMarkup(pos);
+            if (next == std::string::npos) break; // Incomplete token, wait for more data
+            pos = next;
+            
+            if (isComplete()) {
+                buffer_.clear();
+                return false;
+            }
+        }
+        
+        buffer_.erase(0, pos);
+        return true;
+    }
+    
+    bool isComplete() const { return chaptersClosed_ && titleFound_; }
+    bool foundChapterList() const { return chaptersSeen_; }
+    size_t linkCount() const { return linkCount_; }
+    std::string title() const { return StringUtils::trim(decodeEntities(title_)); }
+    const std::string& baseHref() const { return baseHref_; }
+
+private:
+    static bool isVoidTag(const std::string& tag) {
+        static const char* const voidTags[] = {
+            "area", "base", "br", "col", "embed", "hr", "img", "input",
+            "link", "meta", "param", "source", "track", "wbr"
+        };
+        for (const char* voidTag : voidTags) {
+            if (tag == voidTag) return true;
+        }
+        return false;
+    }
+    
+    static std::string decodeEntities(const std::string& text) {
+        if (text.find('&') == std::string::npos) return text;
+        
+        static const std::pair<const char*, char> entities[] = {
+            {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&#39;", '\''}, {"&apos;", '\''}
+        };
+        std::string result;
+        result.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i) {
+            bool replaced = false;
+            if (text[i] == '&') {
+                for (const auto& entity : entities) {
+                    size_t len = std::strlen(entity.first);
+                    if (text.compare(i, len, entity.first) == 0) {
+                        result += entity.second;
+                        i += len - 1;
+                        replaced = true;
+                        break;
+                    }
+                }
+            }
+            if (!replaced) result += text[i];
+        }
+        return result;
+    }
+    
+    void appendText(size_t begin, size_t end) {
+        if (titleDepth_ > 0 && end > begin) {
+            title_.append(buffer_, begin, end - begin); // Decoded in title(), entities may span chunks
+        }
+    }
+    
+    size_t findEndTag(size_t from, const std::string& tag) const {
+        for (size_t pos = buffer_.find("</", from); pos != std::string::npos; pos = buffer_.find("</", pos + 2)) {
+            if (pos + 2 + tag.size() > buffer_.size()) return std::string::npos;
+            if (strncasecmp(buffer_.c_str() + pos + 2, tag.c_str(), tag.size()) == 0) {
+                size_t close = buffer_.find('>', pos);
+                return close == std::string::npos ? std::string::npos : close + 1;
+            }
+        }
+        return std::string::npos;
+    }
+    
+    // Consumes the markup starting at buffer_[pos] == '<' and returns the
+    // position after it, or npos if the token is not complete yet
+    size_t consumeMarkup(size_t pos) {
+        if (pos + 1 >= buffer_.size()) return std::string::npos;
+        char next = buffer_[pos + 1];
+        
+        if (buffer_.compare(pos, 4, "<!--") == 0) {
+            size_t end = buffer_.find("-->", pos + 4);
+            return end == std::string::npos ? std::string::npos : end + 3;
+        }
+        if (buffer_.size() - pos < 4 && next == '!') return std::string::npos;
+        
+        if (next == '!' || next == '?') {
+            size_t end = buffer_.find('>', pos);
+            return end == std::string::npos ? std::string::npos : end + 1;
+        }
+        
+        bool endTag = next == '/';
+        size_t nameStart = pos + (endTag ? 2 : 1);
+        if (nameStart >= buffer_.size()) return std::string::npos;
+        if (!std::isalpha(static_cast<unsigned char>(buffer_[nameStart]))) {
+            appendText(pos, pos + 1); // A stray '<' is plain text
+            return pos + 1;
+        }
+        
+        // Find the closing '>' outside of quoted attribute values
+        char quote = 0;
+        size_t end = nameStart;
+        for (; end < buffer_.size(); ++end) {
+            char c = buffer_[end];
+            if (quote) {
+                if (c == quote) quote = 0;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '>') {
+                break;
+            }
+        }
+        if (end >= buffer_.size()) return std::string::npos;
+        
+        size_t nameEnd = nameStart;
+        while (nameEnd < end && !std::isspace(static_cast<unsigned char>(buffer_[nameEnd])) &&
+               buffer_[nameEnd] != '/' && buffer_[nameEnd] != '>') {
+            ++nameEnd;
+        }
+        std::string name = StringUtils::toLower(buffer_.substr(nameStart, nameEnd - nameStart));
+        
+        if (endTag) {
+            handleEndTag(name);
+        } else {
+            bool selfClosing = end > nameEnd && buffer_[end - 1] == '/';
+            handleStartTag(name, nameEnd, end, selfClosing);
+        }
+        return end + 1;
+    }
+    
+    // Extracts the value of `wanted` from the attribute text in buffer_[begin, end)
+    bool readAttribute(size_t begin, size_t end, const char* wanted, std::string& value) const {
+        size_t pos = begin;
+        size_t wantedLen = std::strlen(wanted);
+        
+        while (pos < end) {
+            while (pos < end && (std::isspace(static_cast<unsigned char>(buffer_[pos])) || buffer_[pos] == '/')) ++pos;
+            size_t nameStart = pos;
+            while (pos < end && buffer_[pos] != '=' && buffer_[pos] != '/' &&
+                   !std::isspace(static_cast<unsigned char>(buffer_[pos]))) {
+                ++pos;
+            }
+            size_t nameLen = pos - nameStart;
+            while (pos < end && std::isspace(static_cast<unsigned char>(buffer_[pos]))) ++pos;
+            
+            size_t valueStart = pos;
+            size_t valueEnd = pos;
+            if (pos < end && buffer_[pos] == '=') {
+                ++pos;
+                while (pos < end && std::isspace(static_cast<unsigned char>(buffer_[pos]))) ++pos;
+                if (pos < end && (buffer_[pos] == '"' || buffer_[pos] == '\'')) {
+                    char quote = buffer_[pos++];
+                    valueStart = pos;
+                    while (pos < end && buffer_[pos] != quote) ++pos;
+                    valueEnd = pos;
+                    if (pos < end) ++pos;
+                } else {
+                    valueStart = pos;
+                    while (pos < end && !std::isspace(static_cast<unsigned char>(buffer_[pos]))) ++pos;
+                    valueEnd = pos;
+                }
+            }
+            
+            if (nameLen == wantedLen && strncasecmp(buffer_.c_str() + nameStart, wanted, wantedLen) == 0) {
+                value = decodeEntities(buffer_.substr(valueStart, valueEnd - valueStart));
+                return true;
+            }
+            if (nameLen == 0 && pos == valueStart) ++pos; // Skip unparseable characters
+        }
+        return false;
+    }
+    
+    void handleStartTag(const std::string& name, size_t attrBegin, size_t attrEnd, bool selfClosing) {
+        std::string value;
+        
+        if (chaptersDepth_ > 0 && name == "a") {
+            if ((readAttribute(attrBegin, attrEnd, "href", value) ||
+                 readAttribute(attrBegin, attrEnd, "src", value)) && !value.empty()) {
+                ++linkCount_;
+                onLink_(value);
+            }
+        } else if (infoDepth_ > 0 && !titleFound_ && titleDepth_ == 0 && name == "h1") {
+            titleDepth_ = openTags_.size() + 1;
+        } else if (name == "base" && baseHref_.empty() && readAttribute(attrBegin, attrEnd, "href", value)) {
+            baseHref_ = StringUtils::trim(value);
+        }
+        
+        if (name == "script" || name == "style") {
+            if (!selfClosing) rawTextTag_ = name;
+            return;
+        }
+        if (selfClosing || isVoidTag(name)) return;
+        
+        openTags_.push_back(name);
+        
+        // Either container may sit inside the other, so each is looked for while the other is open
+        bool wantChapters = chaptersDepth_ == 0 && !chaptersClosed_;
+        bool wantInfo = infoDepth_ == 0 && !titleFound_;
+        if ((wantChapters || wantInfo) && readAttribute(attrBegin, attrEnd, "id", value)) {
+            if (wantChapters && value == chaptersId_) {
+                chaptersDepth_ = openTags_.size();
+                chaptersSeen_ = true;
+            } else if (wantInfo && value == titleId_) {
+                infoDepth_ = openTags_.size();
+            }
+        }
+    }
+    
+    void handleEndTag(const std::string& name) {
+        // Pop back to the nearest matching open element; stray end tags are ignored
+        auto it = std::find(openTags_.rbegin(), openTags_.rend(), name);
+        if (it == openTags_.rend()) return;
+        openTags_.resize(openTags_.rend() - it - 1);
+        
+        if (titleDepth_ > openTags_.size()) {
+            titleDepth_ = 0;
+            titleFound_ = !title().empty();
+            if (!titleFound_) title_.clear();
+        }
+        if (infoDepth_ > openTags_.size()) {
+            infoDepth_ = 0;
+        }
+        if (chaptersDepth_ > openTags_.size()) {
+            chaptersDepth_ = 0;
+            chaptersClosed_ = true;
+        }
+    }
+};
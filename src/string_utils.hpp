@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ============================================================================
+// STRING UTILITIES
+// ============================================================================
+
+// Natural-order sort keys for a list of strings, encoded once into a shared
+// pool so sorting compares bytes instead of re-tokenizing on every comparison.
+//
+// Text is lowercased. Each number, including a decimal fraction such as
+// "12.5", becomes '0', the digit count of its integer part, the digits without
+// leading zeros, then 0x01 plus the fraction digits if any, and a 0x00
+// terminator. Byte-wise comparison of two keys then follows natural order, and
+// numbers of any length compare correctly.
+class NaturalSortKeys {
+public:
+    struct Key {
+        uint64_t head;    // First 8 key bytes after the prefix shared by all keys, big-endian
+        uint32_t offset;  // Key start in the pool
+        uint32_t length;
+    };
+    
+private:
+    std::string pool_;
+    std::vector<Key> keys_;
+    size_t commonPrefix_ = 0;
+    
+public:
+    explicit NaturalSortKeys(const std::vector<std::string>& values) {
+        keys_.reserve(values.size());
+        for (const auto& value : values) {
+            size_t offset = pool_.size();
+            encode(value, pool_);
+            if (pool_.size() > std::numeric_limits<uint32_t>::max()) {
+                throw std::length_error("Natural sort key pool exceeds 4 GiB");
+            }
+            keys_.push_back({0, static_cast<uint32_t>(offset), static_cast<uint32_t>(pool_.size() - offset)});
+        }
+        
+        // Series URLs share a long prefix; skip it so the head word decides most comparisons
+        if (!keys_.empty()) {
+            std::string_view first = key(0);
+            commonPrefix_ = first.size();
+            for (size_t i = 1; i < keys_.size() && commonPrefix_ > 0; ++i) {
+                std::string_view other = key(i);
+                size_t limit = std::min(commonPrefix_, other.size());
+                size_t matched = 0;
+                while (matched < limit && first[matched] == other[matched]) ++matched;
+                commonPrefix_ = matched;
+            }
+        }
+        
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            std::string_view rest = key(i).substr(commonPrefix_);
+            uint64_t head = 0;
+            for (size_t j = 0; j < 8; ++j) {
+                head = (head << 8) | (j < rest.size() ? static_cast<unsigned char>(rest[j]) : 0u);
+            }
+            keys_[i].head = head;
+        }
+    }
+    
+    static void encode(std::string_view value, std::string& out) {
+        size_t i = 0;
+        size_t n = value.size();
+        
+        while (i < n) {
+            unsigned char c = static_cast<unsigned char>(value[i]);
+            if (!std::isdigit(c)) {
+                out += static_cast<char>(std::tolower(c));
+                ++i;
+                continue;
+            }
+            
+            size_t start = i;
+            while (i < n && std::isdigit(static_cast<unsigned char>(value[i]))) ++i;
+            while (start + 1 < i && value[start] == '0') ++start;
+            
+            size_t digits = i - start;
+            out += '0';
+            out += static_cast<char>(std::min<size_t>(digits, 255));
+            out.append(value, start, digits);
+            
+            if (i + 1 < n && value[i] == '.' && std::isdigit(static_cast<unsigned char>(value[i + 1]))) {
+                size_t fraction = ++i;
+                while (i < n && std::isdigit(static_cast<unsigned char>(value[i]))) ++i;
+                size_t end = i;
+                while (end > fraction && value[end - 1] == '0') --end;
+                if (end > fraction) {
+                    out += '\x01';
+                    out.append(value, fraction, end - fraction);
+                }
+            }
+            out += '\0';
+        }
+    }
+    
+    size_t size() const { return keys_.size(); }
+    
+    std::string_view key(size_t index) const {
+        return std::string_view(pool_).substr(keys_[index].offset, keys_[index].length);
+    }
+    
+    bool less(size_t a, size_t b) const {
+        const Key& x = keys_[a];
+        const Key& y = keys_[b];
+        if (x.head != y.head) return x.head < y.head;
+        
+        size_t skip = commonPrefix_ + 8;
+        std::string_view xRest = key(a);
+        std::string_view yRest = key(b);
+        xRest.remove_prefix(std::min(skip, xRest.size()));
+        yRest.remove_prefix(std::min(skip, yRest.size()));
+        return xRest < yRest;
+    }
+    
+    // Indices of the original values in natural order
+    std::vector<uint32_t> order() const {
+        std::vector<uint32_t> indices(keys_.size());
+        for (uint32_t i = 0; i < indices.size(); ++i) indices[i] = i;
+        std::sort(indices.begin(), indices.end(), [this](uint32_t a, uint32_t b) { return less(a, b); });
+        return indices;
+    }
+};
+
+class StringUtils {
+public:
+    static std::string trim(std::string_view str) {
+        return std::string(trimmed(str));
+    }
+    
+    // Same as trim(), as a view into `str`
+    static std::string_view trimmed(std::string_view str) {
+        size_t start = str.find_first_not_of(" \t\n\r");
+        if (start == std::string_view::npos) return {};
+        size_t end = str.find_last_not_of(" \t\n\r");
+        return str.substr(start, end - start + 1);
+    }
+    
+    static std::string toLower(const std::string& str) {
+        std::string result = str;
+        std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+        return result;
+    }
+    
+    static std::string createSafeFilename(const std::string& title) {
+        std::string filename = toLower(trim(title));
+        
+        // Replace spaces and special characters
+        std::regex specialChars(R"([^\w\-_\.])", std::regex_constants::icase);
+        filename = std::regex_replace(filename, specialChars, "_");
+        
+        // Replace multiple underscores with single
+        std::regex multipleUnderscores("_{2,}");
+        filename = std::regex_replace(filename, multipleUnderscores, "_");
+        
+        // Remove leading/trailing underscores
+        if (!filename.empty() && filename.front() == '_') filename.erase(0, 1);
+        if (!filename.empty() && filename.back() == '_') filename.pop_back();
+        
+        return filename.empty() ? "chapters" : filename;
+    }
+    
+    // FNV-1a, stable across builds and platforms unlike std::hash, for names
+    // and keys that outlive the process
+    static uint64_t stableHash(std::string_view value) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : value) {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+        return hash;
+    }
+    
+    // JSON string literal, quotes included
+    static std::string quoteJson(std::string_view value) {
+        std::string out;
+        out.reserve(value.size() + 2);
+        out += '"';
+        for (unsigned char c : value) {
+            switch (c) {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                default:
+                    if (c < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        out += escaped;
+                    } else {
+                        out += static_cast<char>(c);
+                    }
+            }
+        }
+        out += '"';
+        return out;
+    }
+    
+    // Natural order comparator ("1, 2, 10" instead of "1, 10, 2"). Encodes both
+    // strings on every call; prefer sortNaturally() for whole lists.
+    static bool naturalSort(const std::string& a, const std::string& b) {
+        std::string aKey;
+        std::string bKey;
+        NaturalSortKeys::encode(a, aKey);
+        NaturalSortKeys::encode(b, bKey);
+        return aKey < bKey;
+    }
+    
+    // Sorts values in natural order, building each sort key exactly once
+    static void sortNaturally(std::vector<std::string>& values) {
+        NaturalSortKeys keys(values);
+        std::vector<std::string> sorted;
+        sorted.reserve(values.size());
+        for (uint32_t index : keys.order()) {
+            sorted.push_back(std::move(values[index]));
+        }
+        values = std::move(sorted);
+    }
+};
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "response_cache.hpp"
+#include "string_utils.hpp"
+
+// ============================================================================
+// TRAFFIC ARCHIVE
+// ============================================================================
+
+// Recorded HTTP exchanges in one append-only file:
+//
+//   "LXARCH1\n"  record*  index  trailer
+//
+// A record is a RecordHeader, the URL, the response headers as "name: value\n"
+// lines and the body, padded to 8 bytes. The index lists (URL hash, record
+// offset) sorted by hash, and the trailer at the very end points at it.
+// Recording into an existing archive appends after the old index and writes a
+// new, complete one on close; an archive whose index was never written (the
+// recorder crashed) is still readable by scanning its records.
+struct ArchiveFormat {
+    static constexpr char kFileMagic[8] = {'L', 'X', 'A', 'R', 'C', 'H', '1', '\n'};
+    static constexpr char kRecordMagic[4] = {'L', 'X', 'R', 'C'};
+    static constexpr char kIndexMagic[4] = {'L', 'X', 'I', 'X'};
+    static constexpr char kTrailerMagic[8] = {'L', 'X', 'I', 'N', 'D', 'E', 'X', '\n'};
+    static constexpr uint32_t kTruncated = 1; // The client stopped reading before the body ended
+    
+    struct RecordHeader {
+        char magic[4];
+        uint32_t flags;
+        uint32_t status;
+        uint32_t urlSize;
+        uint32_t headersSize;
+        uint32_t reserved;
+        uint64_t bodySize;
+        uint64_t firstByteMicros;
+        uint64_t totalMicros;
+    };
+    
+    struct IndexHeader {
+        char magic[4];
+        uint32_t reserved;
+        uint64_t count;
+    };
+    
+    struct IndexEntry {
+        uint64_t hash;
+        uint64_t offset;
+        
+        bool operator<(const IndexEntry& other) const {
+            return hash != other.hash ? hash < other.hash : offset < other.offset;
+        }
+    };
+    
+    struct Trailer {
+        char magic[8];
+        uint64_t indexOffset;
+    };
+    
+    static uint64_t hash(std::string_view url) { return StringUtils::stableHash(url); }
+    
+    static uint64_t padded(uint64_t size) { return (size + 7) & ~uint64_t(7); }
+    
+    static uint64_t recordSize(const RecordHeader& header) {
+        return sizeof(RecordHeader) + padded(uint64_t(header.urlSize) + header.headersSize + header.bodySize);
+    }
+};
+
+// One recorded response; the views point into the archive's mapping
+struct ArchivedResponse {
+    std::string_view url;
+    std::string_view headers; // "name: value\n" lines, names lowercased
+    std::string_view body;
+    long status = 0;
+    double firstByteSeconds = 0.0;
+    double totalSeconds = 0.0;
+    bool truncated = false;
+    
+    std::map<std::string, std::string> headerMap() const {
+        std::map<std::string, std::string> result;
+        std::string_view rest = headers;
+        while (!rest.empty()) {
+            size_t newline = rest.find('\n');
+            std::string_view line = rest.substr(0, newline);
+            rest.remove_prefix(newline == std::string_view::npos ? rest.size() : newline + 1);
+            size_t colon = line.find(": ");
+            if (colon != std::string_view::npos) {
+                result[std::string(line.substr(0, colon))] = std::string(line.substr(colon + 2));
+            }
+        }
+        return result;
+    }
+};
+
+// Read side, for --replay. Lookups binary-search the index in place and
+// return views into the mapped file, so replayed bodies are never copied.
+class TrafficArchive {
+private:
+    std::unique_ptr<MappedFile> file_;
+    const ArchiveFormat::IndexEntry* index_ = nullptr;
+    size_t count_ = 0;
+    std::vector<ArchiveFormat::IndexEntry> scanned_; // Rebuilt index of an archive without one
+
+public:
+    // Throws std::runtime_error if the file is missing or not an archive
+    explicit TrafficArchive(const std::string& path) : file_(std::make_unique<MappedFile>(path)) {
+        std::string_view data = file_->data();
+        if (!file_->isOpen() || data.size() < sizeof(ArchiveFormat::kFileMagic) ||
+            data.compare(0, sizeof(ArchiveFormat::kFileMagic),
+                         std::string_view(ArchiveFormat::kFileMagic, sizeof(ArchiveFormat::kFileMagic))) != 0) {
+            throw std::runtime_error("Not a traffic archive: " + path);
+        }
+        if (!readIndex()) {
+            scanned_ = scan();
+            index_ = scanned_.data();
+            count_ = scanned_.size();
+        }
+    }
+    
+    size_t size() const { return count_; }
+    
+    std::vector<ArchiveFormat::IndexEntry> entries() const {
+        return std::vector<ArchiveFormat::IndexEntry>(index_, index_ + count_);
+    }
+    
+    // The most recent recording of `url`
+    bool find(std::string_view url, ArchivedResponse& response) const {
+        ArchiveFormat::IndexEntry key{ArchiveFormat::hash(url), 0};
+        const ArchiveFormat::IndexEntry* end = index_ + count_;
+        const ArchiveFormat::IndexEntry* first = std::lower_bound(index_, end, key);
+        for (const ArchiveFormat::IndexEntry* it = std::upper_bound(first, end, ArchiveFormat::IndexEntry{key.hash, UINT64_MAX});
+             it != first;) {
+            --it;
+            if (read(it->offset, response) && response.url == url) return true;
+        }
+        return false;
+    }
+
+private:
+    bool readIndex() {
+        std::string_view data = file_->data();
+        if (data.size() < sizeof(ArchiveFormat::kFileMagic) + sizeof(ArchiveFormat::Trailer)) return false;
+        
+        ArchiveFormat::Trailer trailer;
+        std::memcpy(&trailer, data.data() + data.size() - sizeof(trailer), sizeof(trailer));
+        if (std::memcmp(trailer.magic, ArchiveFormat::kTrailerMagic, sizeof(trailer.magic)) != 0 ||
+            trailer.indexOffset % 8 != 0 || trailer.indexOffset + sizeof(ArchiveFormat::IndexHeader) > data.size()) {
+            return false;
+        }
+        
+        ArchiveFormat::IndexHeader header;
+        std::memcpy(&header, data.data() + trailer.indexOffset, sizeof(header));
+        uint64_t entriesEnd = trailer.indexOffset + sizeof(header) + header.count * sizeof(ArchiveFormat::IndexEntry);
+        if (std::memcmp(header.magic, ArchiveFormat::kIndexMagic, sizeof(header.magic)) != 0 ||
+            entriesEnd + sizeof(trailer) != data.size()) {
+            return false;
+        }
+        // Mappings are page-aligned and the index sits at a multiple of 8
+        index_ = reinterpret_cast<const ArchiveFormat::IndexEntry*>(data.data() + trailer.indexOffset + sizeof(header));
+        count_ = header.count;
+        return true;
+    }
+    
+    // Walks every record; stops at the first incomplete one
+    std::vector<ArchiveFormat::IndexEntry> scan() const {
+        std::string_view data = file_->data();
+        std::vector<ArchiveFormat::IndexEntry> entries;
+        uint64_t offset = sizeof(ArchiveFormat::kFileMagic);
+        ArchivedResponse response;
+        while (offset + sizeof(ArchiveFormat::IndexHeader) <= data.size()) {
+            if (std::memcmp(data.data() + offset, ArchiveFormat::kIndexMagic, 4) == 0) {
+                ArchiveFormat::IndexHeader header;
+                std::memcpy(&header, data.data() + offset, sizeof(header));
+                offset += sizeof(header) + header.count * sizeof(ArchiveFormat::IndexEntry) +
+                          sizeof(ArchiveFormat::Trailer);
+                continue;
+            }
+            if (!read(offset, response)) break;
+            entries.push_back({ArchiveFormat::hash(response.url), offset});
+            
+            ArchiveFormat::RecordHeader header;
+            std::memcpy(&header, data.data() + offset, sizeof(header));
+            offset += ArchiveFormat::recordSize(header);
+        }
+        std::sort(entries.begin(), entries.end());
+        return entries;
+    }
+    
+    bool read(uint64_t offset, ArchivedResponse& response) const {
+        std::string_view data = file_->data();
+        if (offset + sizeof(ArchiveFormat::RecordHeader) > data.size()) return false;
+        
+        ArchiveFormat::RecordHeader header;
+        std::memcpy(&header, data.data() + offset, sizeof(header));
+        if (std::memcmp(header.magic, ArchiveFormat::kRecordMagic, sizeof(header.magic)) != 0 ||
+            offset + ArchiveFormat::recordSize(header) > data.size()) {
+            return false;
+        }
+        
+        const char* payload = data.data() + offset + sizeof(header);
+        response.url = std::string_view(payload, header.urlSize);
+        response.headers = std::string_view(payload + header.urlSize, header.headersSize);
+        response.body = std::string_view(payload + header.urlSize + header.headersSize, header.bodySize);
+        response.status = static_cast<long>(header.status);
+        response.firstByteSeconds = header.firstByteMicros / 1e6;
+        response.totalSeconds = header.totalMicros / 1e6;
+        response.truncated = header.flags & ArchiveFormat::kTruncated;
+        return true;
+    }
+};
+
+// Write side, for --record. Records from concurrent transfers are appended
+// under a lock with one pwritev each; the index is written by close().
+class TrafficRecorder {
+private:
+    std::string path_;
+    int fd_ = -1;
+    std::mutex mutex_;
+    uint64_t end_ = 0;
+    std::vector<ArchiveFormat::IndexEntry> index_;
+    bool failed_ = false;
+
+public:
+    // Appends to `path`, creating it if needed. Throws std::runtime_error on failure.
+    explicit TrafficRecorder(const std::string& path) : path_(path) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Could not open archive " + path + ": " + std::strerror(errno));
+        }
+        // The destructor does not run for a constructor that throws
+        try {
+            off_t size = ::lseek(fd_, 0, SEEK_END);
+            if (size > 0) {
+                index_ = TrafficArchive(path).entries(); // Throws for a file that is not an archive
+                end_ = ArchiveFormat::padded(static_cast<uint64_t>(size));
+            } else if (::pwrite(fd_, ArchiveFormat::kFileMagic, sizeof(ArchiveFormat::kFileMagic), 0) !=
+                       static_cast<ssize_t>(sizeof(ArchiveFormat::kFileMagic))) {
+                throw std::runtime_error("Could not write archive " + path + ": " + std::strerror(errno));
+            } else {
+                end_ = sizeof(ArchiveFormat::kFileMagic);
+            }
+        } catch (...) {
+            ::close(fd_);
+            fd_ = -1;
+            throw;
+        }
+    }
+    
+    ~TrafficRecorder() { close(); }
+    
+    TrafficRecorder(const TrafficRecorder&) = delete;
+    TrafficRecorder& operator=(const TrafficRecorder&) = delete;
+    
+    const std::string& path() const { return path_; }
+    
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return index_.size();
+    }
+    
+    void record(const std::string& url, long status, const std::map<std::string, std::string>& headers,
+                std::string_view body, double firstByteSeconds, double totalSeconds, bool truncated) {
+        std::string headerLines;
+        for (const auto& [name, value] : headers) {
+            headerLines.append(name).append(": ").append(value) += '\n';
+        }
+        
+        ArchiveFormat::RecordHeader header{};
+        std::memcpy(header.magic, ArchiveFormat::kRecordMagic, sizeof(header.magic));
+        header.flags = truncated ? ArchiveFormat::kTruncated : 0;
+        header.status = static_cast<uint32_t>(status);
+        header.urlSize = static_cast<uint32_t>(url.size());
+        header.headersSize = static_cast<uint32_t>(headerLines.size());
+        header.bodySize = body.size();
+        header.firstByteMicros = static_cast<uint64_t>(firstByteSeconds * 1e6);
+        header.totalMicros = static_cast<uint64_t>(totalSeconds * 1e6);
+        
+        static const char zeros[8] = {};
+        uint64_t size = ArchiveFormat::recordSize(header);
+        uint64_t payload = sizeof(header) + url.size() + headerLines.size() + body.size();
+        iovec parts[] = {
+            {&header, sizeof(header)},
+            {const_cast<char*>(url.data()), url.size()},
+            {headerLines.data(), headerLines.size()},
+            {const_cast<char*>(body.data()), body.size()},
+            {const_cast<char*>(zeros), size - payload},
+        };
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ < 0 || failed_) return;
+        if (!writeAt(parts, 5, end_, size)) return;
+        index_.push_back({ArchiveFormat::hash(url), end_});
+        end_ += size;
+    }
+    
+    // Writes the index; false if any record or the index could not be written
+    bool close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ < 0) return !failed_;
+        
+        std::sort(index_.begin(), index_.end());
+        ArchiveFormat::IndexHeader header{};
+        std::memcpy(header.magic, ArchiveFormat::kIndexMagic, sizeof(header.magic));
+        header.count = index_.size();
+        ArchiveFormat::Trailer trailer{};
+        std::memcpy(trailer.magic, ArchiveFormat::kTrailerMagic, sizeof(trailer.magic));
+        trailer.indexOffset = end_;
+        
+        uint64_t entries = index_.size() * sizeof(ArchiveFormat::IndexEntry);
+        iovec parts[] = {
+            {&header, sizeof(header)},
+            {index_.data(), entries},
+            {&trailer, sizeof(trailer)},
+        };
+        if (!failed_) {
+            writeAt(parts, 3, end_, sizeof(header) + entries + sizeof(trailer));
+        }
+        if (::close(fd_) != 0) failed_ = true;
+        fd_ = -1;
+        return !failed_;
+    }
+
+private:
+    bool writeAt(iovec* parts, int count, uint64_t offset, uint64_t size) {
+        while (size > 0) {
+            ssize_t written = ::pwritev(fd_, parts, count, static_cast<off_t>(offset));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                failed_ = true;
+                return false;
+            }
+            offset += static_cast<uint64_t>(written);
+            size -= static_cast<uint64_t>(written);
+            
+            size_t remaining = static_cast<size_t>(written);
+            while (count > 0 && remaining >= parts->iov_len) {
+                remaining -= parts->iov_len;
+                ++parts;
+                --count;
+            }
+            if (count > 0) {
+                parts->iov_base = static_cast<char*>(parts->iov_base) + remaining;
+                parts->iov_len -= remaining;
+            }
+        }
+        return true;
+    }
+};
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <string_view>
+
+// ============================================================================
+// URL UTILITIES
+// ============================================================================
+
+class URLUtils {
+public:
+    // Components of a URI reference, as views into the original string
+    struct Parts {
+        std::string_view scheme;
+        std::string_view authority;
+        std::string_view path;
+        std::string_view query;
+        std::string_view fragment;
+        bool hasAuthority = false;
+        bool hasQuery = false;
+        bool hasFragment = false;
+    };
+    
+    static Parts split(std::string_view url) {
+        Parts parts;
+        size_t colon = url.find(':');
+        if (colon != std::string_view::npos && colon > 0 && colon < endOfAuthority(url, 0) &&
+            std::isalpha(static_cast<unsigned char>(url[0]))) {
+            parts.scheme = url.substr(0, colon);
+            url.remove_prefix(colon + 1);
+        }
+        if (url.compare(0, 2, "//") == 0) {
+            size_t end = endOfAuthority(url, 2);
+            parts.authority = url.substr(2, end == std::string_view::npos ? end : end - 2);
+            parts.hasAuthority = true;
+            url.remove_prefix(std::min(end, url.size()));
+        }
+        size_t hash = url.find('#');
+        if (hash != std::string_view::npos) {
+            parts.fragment = url.substr(hash + 1);
+            parts.hasFragment = true;
+            url = url.substr(0, hash);
+        }
+        size_t question = url.find('?');
+        if (question != std::string_view::npos) {
+            parts.query = url.substr(question + 1);
+            parts.hasQuery = true;
+            url = url.substr(0, question);
+        }
+        parts.path = url;
+        return parts;
+    }
+    
+    // Resolves a reference (an href) against an absolute base URL as in
+    // RFC 3986 section 5.2: "../x", "?page=2", "//host/x", "#top" and so on.
+    // The result is built in one string, with dot segments removed in place.
+    static std::string resolve(std::string_view baseUrl, std::string_view reference) {
+        Parts ref = split(reference);
+        if (!ref.scheme.empty()) {
+            return compose(ref, {}, {});
+        }
+        
+        Parts base = split(baseUrl);
+        Parts target = ref;
+        target.scheme = base.scheme;
+        std::string_view mergeDir;
+        if (!ref.hasAuthority) {
+            target.authority = base.authority;
+            target.hasAuthority = base.hasAuthority;
+            if (ref.path.empty()) {
+                target.path = base.path;
+                if (!ref.hasQuery) {
+                    target.query = base.query;
+                    target.hasQuery = base.hasQuery;
+                }
+            } else if (ref.path.front() != '/') {
+                // Merge: the base path up to its last '/', or "/" below a bare authority
+                size_t slash = base.path.rfind('/');
+                mergeDir = slash == std::string_view::npos ? std::string_view(base.hasAuthority ? "/" : "")
+                                                           : base.path.substr(0, slash + 1);
+            }
+        }
+        return compose(target, mergeDir, {});
+    }
+    
+    // Canonical form of an http(s) URL, used to compare links: lowercase scheme
+    // and host, no default port, no dot segments, no trailing slash (except the
+    // root), no tracking parameters, no fragment, uppercase percent-escapes
+    static std::string normalize(std::string_view url) {
+        Parts parts = split(url);
+        std::string_view port = defaultPort(parts.scheme);
+        if (port.empty() || !parts.hasAuthority) return std::string(url);
+        parts.hasFragment = false;
+        return compose(parts, {}, port);
+    }
+    
+    // Builds the result with a single allocation
+    static std::string join(std::string_view baseUrl, std::string_view relativeUrl) {
+        if (relativeUrl.empty()) return std::string(baseUrl);
+        
+        // If relative URL is already absolute, return it
+        if (isValid(relativeUrl)) {
+            return std::string(relativeUrl);
+        }
+        
+        // Remove trailing slash from base URL
+        if (!baseUrl.empty() && baseUrl.back() == '/') {
+            baseUrl.remove_suffix(1);
+        }
+        
+        // Add leading slash to relative URL if needed
+        bool slash = relativeUrl.front() != '/';
+        
+        std::string result;
+        result.reserve(baseUrl.size() + slash + relativeUrl.size());
+        result.append(baseUrl);
+        if (slash) result += '/';
+        result.append(relativeUrl);
+        return result;
+    }
+    
+    // Scheme and authority of an absolute URL ("https://host:port"), empty if there is none
+    static std::string origin(std::string_view url) {
+        size_t scheme = url.find("://");
+        if (scheme == std::string_view::npos) return "";
+        size_t end = url.find_first_of("/?#", scheme + 3);
+        return std::string(url.substr(0, end));
+    }
+    
+    static bool isValid(std::string_view url) {
+        return url.compare(0, 7, "http://") == 0 || url.compare(0, 8, "https://") == 0;
+    }
+
+private:
+    // First '/', '?' or '#' at or after `from`; find_first_of tests each character with a call
+    static size_t endOfAuthority(std::string_view url, size_t from) {
+        for (size_t i = from; i < url.size(); ++i) {
+            if (url[i] == '/' || url[i] == '?' || url[i] == '#') return i;
+        }
+        return std::string_view::npos;
+    }
+    
+    static std::string_view defaultPort(std::string_view scheme) {
+        if (equalsIgnoreCase(scheme, "http")) return "80";
+        if (equalsIgnoreCase(scheme, "https")) return "443";
+        return {};
+    }
+    
+    static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (std::tolower(static_cast<unsigned char>(a[i])) != b[i]) return false;
+        }
+        return true;
+    }
+    
+    // Reassembles `parts` with `mergeDir` in front of the path. A non-empty
+    // `canonicalPort` selects normalize()'s rewriting; resolve() keeps the
+    // components as they were written, minus dot segments.
+    static std::string compose(const Parts& parts, std::string_view mergeDir, std::string_view canonicalPort) {
+        bool canonical = !canonicalPort.empty();
+        std::string out;
+        out.reserve(parts.scheme.size() + parts.authority.size() + mergeDir.size() + parts.path.size() +
+                    parts.query.size() + parts.fragment.size() + 6);
+        
+        if (!parts.scheme.empty()) {
+            appendLower(out, parts.scheme, canonical);
+            out += ':';
+        }
+        if (parts.hasAuthority) {
+            out += "//";
+            appendAuthority(out, parts.authority, canonicalPort);
+        }
+        
+        size_t pathStart = out.size();
+        out.append(mergeDir);
+        appendEscaped(out, parts.path, canonical);
+        removeDotSegments(out, pathStart);
+        if (canonical) {
+            if (out.size() == pathStart) out += '/';
+            else if (out.size() > pathStart + 1 && out.back() == '/') out.pop_back();
+        }
+        
+        if (parts.hasQuery) {
+            if (canonical) {
+                appendQueryWithoutTracking(out, parts.query);
+            } else {
+                out += '?';
+                out.append(parts.query);
+            }
+        }
+        if (parts.hasFragment) {
+            out += '#';
+            out.append(parts.fragment);
+        }
+        return out;
+    }
+    
+    static void appendLower(std::string& out, std::string_view text, bool lower) {
+        for (char c : text) {
+            out += lower ? static_cast<char>(std::tolower(static_cast<unsigned char>(c))) : c;
+        }
+    }
+    
+    // Uppercases the hex digits of %-escapes when canonicalizing
+    static void appendEscaped(std::string& out, std::string_view text, bool canonical) {
+        if (!canonical || text.find('%') == std::string_view::npos) {
+            out.append(text);
+            return;
+        }
+        for (size_t i = 0; i < text.size(); ++i) {
+            bool hexDigit = std::isxdigit(static_cast<unsigned char>(text[i])) &&
+                            ((i >= 1 && text[i - 1] == '%') || (i >= 2 && text[i - 2] == '%'));
+            out += hexDigit ? static_cast<char>(std::toupper(static_cast<unsigned char>(text[i]))) : text[i];
+        }
+    }
+    
+    // userinfo@host:port with the host lowercased and a default port dropped
+    static void appendAuthority(std::string& out, std::string_view authority, std::string_view canonicalPort) {
+        if (canonicalPort.empty()) {
+            out.append(authority);
+            return;
+        }
+        size_t at = authority.rfind('@');
+        if (at != std::string_view::npos) {
+            out.append(authority.substr(0, at + 1));
+            authority.remove_prefix(at + 1);
+        }
+        size_t colon = authority.rfind(':');
+        if (colon != std::string_view::npos && authority.find(']', colon) == std::string_view::npos) {
+            std::string_view port = authority.substr(colon + 1);
+            authority = authority.substr(0, colon);
+            appendLower(out, authority, true);
+            if (!port.empty() && port != canonicalPort) {
+                out += ':';
+                out.append(port);
+            }
+            return;
+        }
+        appendLower(out, authority, true);
+    }
+    
+    static bool isTrackingParameter(std::string_view name) {
+        static const std::string_view tracking[] = {
+            "fbclid", "gclid", "dclid", "msclkid", "yclid", "igshid", "mc_cid", "mc_eid", "_ga"
+        };
+        if (name.compare(0, 4, "utm_") == 0) return true;
+        for (std::string_view parameter : tracking) {
+            if (name == parameter) return true;
+        }
+        return false;
+    }
+    
+    static void appendQueryWithoutTracking(std::string& out, std::string_view query) {
+        size_t start = out.size();
+        while (!query.empty()) {
+            size_t amp = query.find('&');
+            std::string_view parameter = query.substr(0, amp);
+            query.remove_prefix(amp == std::string_view::npos ? query.size() : amp + 1);
+            if (parameter.empty() || isTrackingParameter(parameter.substr(0, parameter.find('=')))) continue;
+            out += out.size() == start ? '?' : '&';
+            appendEscaped(out, parameter, true);
+        }
+    }
+    
+    // RFC 3986 section 5.2.4 over out[from, end). Output never overtakes input,
+    // so segments are copied down within the same buffer.
+    static void removeDotSegments(std::string& out, size_t from) {
+        if (from == out.size() || (out[from] != '.' && out.find("/.", from) == std::string::npos)) return;
+        
+        size_t read = from;
+        size_t write = from;
+        size_t end = out.size();
+        auto rest = [&](const char* text) {
+            size_t length = std::char_traits<char>::length(text);
+            return end - read >= length && out.compare(read, length, text) == 0;
+        };
+        auto isRest = [&](const char* text) {
+            return end - read == std::char_traits<char>::length(text) && rest(text);
+        };
+        auto popSegment = [&] {
+            while (write > from && out[write - 1] != '/') --write;
+            if (write > from) --write;
+        };
+        
+        while (read < end) {
+            if (rest("../")) {
+                read += 3;
+            } else if (rest("./")) {
+                read += 2;
+            } else if (rest("/./")) {
+                read += 2;
+            } else if (isRest("/.")) {
+                read += 1;
+                out[read] = '/';
+            } else if (rest("/../")) {
+                read += 3;
+                popSegment();
+            } else if (isRest("/..")) {
+                read += 2;
+                out[read] = '/';
+                popSegment();
+            } else if (isRest(".") || isRest("..")) {
+                read = end;
+            } else {
+                // Move "/segment" (or the leading "segment") to the output
+                size_t next = out.find('/', read + 1);
+                if (next == std::string::npos || next > end) next = end;
+                while (read < next) out[write++] = out[read++];
+            }
+        }
+        out.resize(write);
+    }
+};
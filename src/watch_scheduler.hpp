@@ -0,0 +1,434 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "http_client.hpp"
+#include "logger.hpp"
+#include "manga_scraper.hpp"
+#include "output_sink.hpp"
+#include "url_utils.hpp"
+
+// ============================================================================
+// WATCH SCHEDULER
+// ============================================================================
+
+struct WatchOptions {
+    double minInterval = 600.0;   // Seconds between checks of a series that is releasing
+    double maxInterval = 86400.0; // Seconds between checks of a quiet series
+    size_t workers = 8;           // Checks running at once
+    std::string statePath;        // Schedule kept across restarts, empty = none
+};
+
+// Re-scrapes a list of series for as long as it runs and writes the chapters
+// that are new since the last check to an event stream. A min-heap keyed on
+// each series' next check time decides what runs next; a fixed pool of
+// workers sharing one HTTPClient does the checks.
+//
+// Each series polls at its own interval: a quarter of its mean gap between
+// releases while one is due, growing by half after every quiet check up to
+// maxInterval. Next-check times are jittered and the first pass is spread
+// over minInterval, so checks never arrive in bursts.
+//
+// Per series only the URL and a few numbers stay in memory; the chapters
+// already seen live in the series' .index file, as with --incremental.
+class WatchScheduler {
+public:
+    struct Stats {
+        size_t checks = 0;
+        size_t failures = 0;
+        size_t releases = 0; // Checks that found new chapters
+        size_t chapters = 0; // New chapters reported
+    };
+
+private:
+    struct Series {
+        std::string url;
+        double next = 0.0;        // Wall-clock seconds
+        double lastRelease = 0.0; // 0 = none seen yet
+        float interval = 0.0f;
+        float meanGap = 0.0f;     // Between releases, 0 = unknown
+    };
+    
+    struct Due {
+        double at;
+        uint32_t series;
+        
+        bool operator>(const Due& other) const { return at > other.at; }
+    };
+    
+    enum class Outcome { Failed, Baseline, Quiet, Released };
+    
+    static constexpr double kSaveInterval = 600.0;
+    
+    std::vector<Series> series_;
+    WatchOptions watch_;
+    ScrapeOptions options_;
+    HTTPClient client_;
+    std::shared_ptr<OutputFile> events_;
+    
+    std::mutex mutex_;
+    std::condition_variable queued_;   // Work for the workers
+    std::condition_variable finished_; // A worker is free again
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> due_;
+    std::deque<uint32_t> ready_;
+    size_t busy_ = 0;
+    bool stopping_ = false;
+    std::mt19937 random_{std::random_device{}()};
+    
+    std::atomic<size_t> checks_{0};
+    std::atomic<size_t> failures_{0};
+    std::atomic<size_t> releases_{0};
+    std::atomic<size_t> chapters_{0};
+
+public:
+    // Chapters go to `events` in options.format; invalid URLs are skipped
+    WatchScheduler(const std::vector<std::string>& urls, const WatchOptions& watch, const ScrapeOptions& options,
+                   const HTTPClientOptions& clientOptions, std::shared_ptr<OutputFile> events)
+        : watch_(watch), options_(options), client_(clientOptions), events_(std::move(events)) {
+        watch_.workers = std::max<size_t>(1, watch_.workers);
+        watch_.maxInterval = std::max(watch_.minInterval, watch_.maxInterval);
+        options_.incremental = true;
+        options_.showProgress = false;
+        options_.toStdout = false;
+        options_.unsorted = false;
+        options_.output = nullptr;
+        if (!options_.selectors) {
+            options_.selectors = PageSelectors::defaults();
+        }
+        
+        series_.reserve(urls.size());
+        for (const auto& url : urls) {
+            if (!URLUtils::isValid(url)) {
+                Logger::warning("Skipping invalid URL: " + url);
+                continue;
+            }
+            Series series;
+            series.url = url;
+            series.interval = static_cast<float>(watch_.minInterval);
+            series_.push_back(std::move(series));
+        }
+    }
+    
+    WatchScheduler(const WatchScheduler&) = delete;
+    WatchScheduler& operator=(const WatchScheduler&) = delete;
+    
+    size_t size() const { return series_.size(); }
+    
+    // Checks series as they fall due until `stop` is set, then lets running
+    // checks finish and saves the schedule
+    void run(const std::atomic<bool>& stop) {
+        schedule();
+        Logger::success("Watching " + std::to_string(series_.size()) + " series with " +
+                        std::to_string(watch_.workers) + " workers, checking every " +
+                        describeInterval(watch_.minInterval) + " to " + describeInterval(watch_.maxInterval));
+        
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < watch_.workers; ++i) {
+            threads.emplace_back([this] { work(); });
+        }
+        
+        double lastSave = now();
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop) {
+            // Series stay in the heap while every worker is busy, so a backlog
+            // drains in due order instead of piling up in the queue
+            double current = now();
+            while (!due_.empty() && due_.top().at <= current && ready_.size() + busy_ < watch_.workers) {
+                ready_.push_back(due_.top().series);
+                due_.pop();
+                queued_.notify_one();
+            }
+            
+            double wait = 0.25; // Notice `stop` promptly
+            if (!due_.empty() && ready_.size() + busy_ < watch_.workers) {
+                wait = std::clamp(due_.top().at - current, 0.0, wait);
+            }
+            finished_.wait_for(lock, std::chrono::duration<double>(wait));
+            
+            if (current - lastSave >= kSaveInterval) {
+                lastSave = current;
+                saveState(lock);
+            }
+        }
+        
+        Logger::info("Shutting down, waiting for " + std::to_string(busy_) + " running checks");
+        stopping_ = true;
+        queued_.notify_all();
+        lock.unlock();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        
+        lock.lock();
+        saveState(lock);
+        Stats s = stats();
+        Logger::success("Made " + std::to_string(s.checks) + " checks (" + std::to_string(s.failures) +
+                        " failed), found " + std::to_string(s.chapters) + " new chapters in " +
+                        std::to_string(s.releases) + " releases");
+    }
+    
+    Stats stats() const {
+        Stats s;
+        s.checks = checks_;
+        s.failures = failures_;
+        s.releases = releases_;
+        s.chapters = chapters_;
+        return s;
+    }
+    
+    // "90", "90s", "15m", "6h" or "2d", in seconds; false if malformed or not positive
+    static bool parseDuration(const std::string& text, double& seconds) {
+        size_t parsed = 0;
+        double value = 0.0;
+        try {
+            value = std::stod(text, &parsed);
+        } catch (const std::exception&) {
+            return false;
+        }
+        std::string unit = text.substr(parsed);
+        double scale = unit.empty() || unit == "s" ? 1.0 : unit == "m" ? 60.0 : unit == "h" ? 3600.0 :
+                       unit == "d" ? 86400.0 : 0.0;
+        if (scale == 0.0 || !(value > 0.0) || !std::isfinite(value)) return false;
+        seconds = value * scale;
+        return true;
+    }
+    
+    // "45s", "10m", "1.5h", "2d"
+    static std::string describeInterval(double seconds) {
+        const char* unit = "s";
+        double value = seconds;
+        if (seconds >= 86400.0) {
+            value = seconds / 86400.0;
+            unit = "d";
+        } else if (seconds >= 3600.0) {
+            value = seconds / 3600.0;
+            unit = "h";
+        } else if (seconds >= 60.0) {
+            value = seconds / 60.0;
+            unit = "m";
+        }
+        value = std::round(value * 10.0) / 10.0;
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(value == std::floor(value) ? 0 : 1) << value << unit;
+        return out.str();
+    }
+
+private:
+    static double now() {
+        return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    
+    // Restores the saved schedule and fills the heap. Series that are new or
+    // overdue (the watcher was down) are spread evenly over minInterval.
+    void schedule() {
+        loadState();
+        double start = now();
+        std::vector<uint32_t> pending;
+        for (uint32_t i = 0; i < series_.size(); ++i) {
+            if (series_[i].next > start) {
+                due_.push(Due{series_[i].next, i});
+            } else {
+                pending.push_back(i);
+            }
+        }
+        std::shuffle(pending.begin(), pending.end(), random_); // Hosts listed together do not fall due together
+        double spacing = pending.empty() ? 0.0 : watch_.minInterval / pending.size();
+        for (size_t k = 0; k < pending.size(); ++k) {
+            Series& series = series_[pending[k]];
+            series.next = start + k * spacing;
+            due_.push(Due{series.next, pending[k]});
+        }
+    }
+    
+    void work() {
+        for (;;) {
+            uint32_t index;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                queued_.wait(lock, [this] { return stopping_ || !ready_.empty(); });
+                if (stopping_) return; // Queued series are overdue at the next start
+                index = ready_.front();
+                ready_.pop_front();
+                ++busy_;
+            }
+            
+            Outcome outcome = check(series_[index].url); // Only `url`, which never changes, is read unlocked
+            
+            std::lock_guard<std::mutex> lock(mutex_);
+            --busy_;
+            reschedule(index, outcome);
+            finished_.notify_one();
+        }
+    }
+    
+    // Scrapes one series against its index and reports the new chapters. The
+    // first check of a series without an index only records what is there.
+    Outcome check(const std::string& url) {
+        ++checks_;
+        Logger::setContext(contextFor(url));
+        Outcome outcome = Outcome::Failed;
+        try {
+            MangaScraper scraper(url, client_, options_);
+            if (scraper.scrape()) {
+                bool baseline = !scraper.index().loaded();
+                size_t added = scraper.delta().added.size();
+                if (!baseline && added > 0) {
+                    emit(scraper);
+                    if (options_.crawlPages) scraper.crawlPages();
+                }
+                if (scraper.saveIndex()) {
+                    outcome = baseline ? Outcome::Baseline : added > 0 ? Outcome::Released : Outcome::Quiet;
+                }
+            }
+        } catch (const std::exception& e) {
+            Logger::error("Check failed: " + std::string(e.what()));
+        }
+        if (outcome == Outcome::Failed) ++failures_;
+        Logger::setContext("");
+        return outcome;
+    }
+    
+    // All of a check's new chapters in one write, numbered like the full list
+    void emit(const MangaScraper& scraper) {
+        const std::vector<std::string>& added = scraper.delta().added;
+        std::unordered_map<std::string, size_t> numbers = scraper.chapterNumbers();
+        
+        std::unique_ptr<ChapterSink> sink = ChapterSink::create(options_.format);
+        sink->attach(events_);
+        sink->setSeries(scraper.title(), scraper.url(), MangaScraper::getCurrentTimestamp());
+        sink->reserve(added);
+        sink->header(added.size());
+        for (const auto& url : added) {
+            sink->add(numbers[url], url);
+        }
+        if (!sink->close()) {
+            Logger::error("Could not write events: " + sink->error());
+            return;
+        }
+        ++releases_;
+        chapters_ += added.size();
+        Logger::success(scraper.title() + ": " + std::to_string(added.size()) + " new chapters");
+    }
+    
+    // Adapts the series' interval to what the check found and puts it back in
+    // the heap. Called with the lock held.
+    void reschedule(uint32_t index, Outcome outcome) {
+        Series& series = series_[index];
+        double current = now();
+        double interval = series.interval;
+        
+        switch (outcome) {
+            case Outcome::Released:
+                if (series.lastRelease > 0.0) {
+                    double gap = current - series.lastRelease;
+                    series.meanGap = static_cast<float>(series.meanGap > 0.0f ? 0.7 * series.meanGap + 0.3 * gap : gap);
+                }
+                series.lastRelease = current;
+                interval = series.meanGap > 0.0f ? series.meanGap / 4.0 : interval / 2.0;
+                break;
+            case Outcome::Quiet:
+            case Outcome::Baseline:
+                interval *= 1.5;
+                // Keep checking closely until a release is well overdue (a hiatus)
+                if (series.meanGap > 0.0f && current - series.lastRelease < 2.0 * series.meanGap) {
+                    interval = std::min(interval, series.meanGap / 4.0);
+                }
+                break;
+            case Outcome::Failed:
+                interval *= 2.0;
+                break;
+        }
+        
+        interval = std::clamp(interval, watch_.minInterval, watch_.maxInterval);
+        series.interval = static_cast<float>(interval);
+        std::uniform_real_distribution<double> jitter(0.9, 1.1);
+        series.next = current + interval * jitter(random_);
+        due_.push(Due{series.next, index});
+    }
+    
+    std::string contextFor(const std::string& url) const {
+        std::string slug = url;
+        while (!slug.empty() && slug.back() == '/') slug.pop_back();
+        return slug.substr(slug.find_last_of('/') + 1);
+    }
+    
+    // One series per line: next check, interval, mean gap, last release, URL
+    void loadState() {
+        if (watch_.statePath.empty()) return;
+        std::ifstream file(watch_.statePath);
+        if (!file.is_open()) return;
+        
+        std::unordered_map<std::string, uint32_t> positions;
+        positions.reserve(series_.size());
+        for (uint32_t i = 0; i < series_.size(); ++i) {
+            positions.emplace(series_[i].url, i);
+        }
+        
+        size_t restored = 0;
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line.front() == '#') continue;
+            std::istringstream fields(line);
+            double next = 0.0, interval = 0.0, meanGap = 0.0, lastRelease = 0.0;
+            std::string url;
+            if (!(fields >> next >> interval >> meanGap >> lastRelease) || !std::getline(fields >> std::ws, url)) continue;
+            
+            auto it = positions.find(url);
+            if (it == positions.end()) continue; // No longer listed
+            Series& series = series_[it->second];
+            series.next = next;
+            series.interval = static_cast<float>(std::clamp(interval, watch_.minInterval, watch_.maxInterval));
+            series.meanGap = static_cast<float>(std::max(0.0, meanGap));
+            series.lastRelease = lastRelease;
+            ++restored;
+        }
+        Logger::info("Restored the schedule of " + std::to_string(restored) + " series from " + watch_.statePath);
+    }
+    
+    // Via a temporary file, like the chapter index. Called with the lock held;
+    // it is released while writing.
+    void saveState(std::unique_lock<std::mutex>& lock) {
+        if (watch_.statePath.empty()) return;
+        std::string text = "# Linkex Watch State\n# next\tinterval\tmean_gap\tlast_release\turl\n";
+        text.reserve(text.size() + series_.size() * 128);
+        char numbers[128];
+        for (const auto& series : series_) {
+            int length = std::snprintf(numbers, sizeof(numbers), "%.0f\t%.0f\t%.0f\t%.0f\t", series.next,
+                                       static_cast<double>(series.interval), static_cast<double>(series.meanGap),
+                                       series.lastRelease);
+            text.append(numbers, static_cast<size_t>(length));
+            text += series.url;
+            text += '\n';
+        }
+        lock.unlock();
+        
+        std::string temp = watch_.statePath + ".tmp";
+        bool saved = false;
+        {
+            std::ofstream file(temp);
+            saved = file.is_open() && (file << text) && file.flush();
+        }
+        saved = saved && std::rename(temp.c_str(), watch_.statePath.c_str()) == 0;
+        if (!saved) {
+            Logger::error("Could not write watch state: " + watch_.statePath);
+        }
+        lock.lock();
+    }
+};